@@ -0,0 +1,35 @@
+-- Automation 4 test file
+-- Test that an error raised partway through subs.apply and caught by the
+-- script leaves the subtitles unchanged
+
+script_name = "TEST apply errors"
+script_description = "Test catching an error from within subs.apply"
+script_author = "Aegisub contributors"
+script_version = "1"
+
+function test_apply_error(subs)
+	local before = {}
+	for i = 1, #subs do
+		before[i] = subs[i].raw
+	end
+
+	local dialogue = 0
+	local ok = pcall(subs.apply, function(line)
+		if line.class ~= "dialogue" then return end
+		dialogue = dialogue + 1
+		if dialogue == 3 then error("stop") end
+		if dialogue % 2 == 1 then return false end
+		line.text = line.text .. " (applied)"
+		return line
+	end)
+	assert(not ok, "apply should have raised the error")
+
+	assert(#subs == #before, "Number of lines changed")
+	for i = 1, #subs do
+		assert(subs[i].raw == before[i], "Line " .. i .. " was changed")
+	end
+
+	aegisub.set_undo_point("apply error test")
+end
+
+aegisub.register_macro("Apply error test", "Raise an error from subs.apply, catch it and check nothing changed", test_apply_error)
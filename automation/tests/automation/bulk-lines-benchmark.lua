@@ -0,0 +1,74 @@
+-- Automation 4 test file
+-- Time generating and modifying a large number of lines with the batch
+-- operations on the subtitles object
+
+script_name = "TEST bulk line operations"
+script_description = "Benchmark inserting, replacing and rewriting 100k lines"
+script_author = "Aegisub contributors"
+script_version = "1"
+
+local line_count = 100000
+
+local function first_dialogue(subs)
+	for i = 1, #subs do
+		if subs[i].class == "dialogue" then return i end
+	end
+end
+
+local function timed(name, func)
+	local start = os.clock()
+	func()
+	aegisub.debug.out("%s: %.3f s\n", name, os.clock() - start)
+end
+
+function benchmark(subs)
+	local first = first_dialogue(subs)
+	if not first then
+		aegisub.debug.out("The file needs at least one dialogue line\n")
+		return
+	end
+
+	local template = subs[first]
+	local generated = {}
+	for i = 1, line_count do
+		local line = {}
+		for k, v in pairs(template) do line[k] = v end
+		line.start_time = i * 10
+		line.end_time = i * 10 + 10
+		line.text = "Generated line " .. i
+		generated[i] = line
+	end
+
+	timed("insert " .. line_count .. " lines", function()
+		subs.insert(first, generated)
+	end)
+	assert(subs[first + line_count].text == template.text)
+
+	timed("rewrite every generated line", function()
+		subs.apply(function(line, i)
+			if i >= first and i < first + line_count then
+				line.text = line.text .. "!"
+				return line
+			end
+		end)
+	end)
+	assert(subs[first].text == "Generated line 1!")
+
+	timed("replace the generated lines with half as many", function()
+		local half = {}
+		for i = 1, line_count / 2 do half[i] = generated[i] end
+		subs.replace_range(first, first + line_count - 1, half)
+	end)
+	assert(subs[first + line_count / 2].text == template.text)
+
+	timed("delete the generated lines", function()
+		subs.apply(function(line, i)
+			if i >= first and i < first + line_count / 2 then return false end
+		end)
+	end)
+	assert(subs[first].text == template.text)
+
+	aegisub.set_undo_point("bulk line operations benchmark")
+end
+
+aegisub.register_macro("Bulk line operations benchmark", "Insert, rewrite and delete 100k lines", benchmark)
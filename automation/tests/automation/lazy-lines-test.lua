@@ -0,0 +1,33 @@
+-- Automation 4 test file
+-- Test that lazy lines read the same values as normal lines and that
+-- writing them back only changes what was modified
+
+script_name = "TEST lazy lines"
+script_description = "Test reading and modifying subtitle lines lazily"
+script_author = "Aegisub contributors"
+script_version = "1"
+
+local fields = {"comment", "layer", "start_time", "end_time", "style",
+	"actor", "effect", "margin_l", "margin_r", "margin_t", "margin_b", "text",
+	"raw", "class", "section"}
+
+function test_lazy(subs)
+	for i, line in subs.lazy_ipairs() do
+		local full = subs[i]
+		for _, field in ipairs(fields) do
+			assert(line[field] == full[field], "Mismatch in field " .. field .. " of line " .. i)
+		end
+
+		if line.class == "dialogue" then
+			local lazy = subs.lazy(i)
+			lazy.text = lazy.text .. " (lazy)"
+			subs[i] = lazy
+			assert(subs[i].text == full.text .. " (lazy)")
+			assert(subs[i].start_time == full.start_time)
+			assert(subs[i].style == full.style)
+		end
+	end
+	aegisub.set_undo_point("lazy lines test")
+end
+
+aegisub.register_macro("Lazy lines test", "Append \" (lazy)\" to every line using lazy lines", test_lazy)
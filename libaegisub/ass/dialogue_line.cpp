@@ -0,0 +1,233 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/ass/dialogue_line.h"
+
+#include "libaegisub/util.h"
+
+#include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
+#include <climits>
+#include <cstring>
+
+namespace {
+using agi::ass::CharRange;
+
+bool is_space(char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+CharRange trim(const char *begin, const char *end) {
+	while (begin != end && is_space(*begin)) ++begin;
+	while (begin != end && is_space(end[-1])) --end;
+	return CharRange(begin, end);
+}
+
+bool starts_with(const char *begin, const char *end, const char *prefix, size_t len) {
+	return size_t(end - begin) >= len && memcmp(begin, prefix, len) == 0;
+}
+
+/// Parse an entire range as a decimal integer, failing on overflow
+bool parse_int(CharRange str, int &out) {
+	auto it = str.begin(), end = str.end();
+	bool negative = false;
+	if (it != end && (*it == '-' || *it == '+'))
+		negative = *it++ == '-';
+	if (it == end) return false;
+
+	// Accumulate towards the sign so that INT_MIN can be parsed without overflow
+	int value = 0;
+	for (; it != end; ++it) {
+		if (*it < '0' || *it > '9') return false;
+		int digit = *it - '0';
+		if (negative) {
+			if (value < (INT_MIN + digit) / 10) return false;
+			value = value * 10 - digit;
+		}
+		else {
+			if (value > (INT_MAX - digit) / 10) return false;
+			value = value * 10 + digit;
+		}
+	}
+	out = value;
+	return true;
+}
+
+/// Parse a leading {=1=2} block, returning the position after it, begin if
+/// the text does not start with one, or nullptr if an id does not fit in
+/// 32 bits
+const char *parse_extradata(const char *begin, const char *end, std::vector<uint32_t> &ids) {
+	ids.clear();
+	if (end - begin < 2 || begin[0] != '{' || begin[1] != '=')
+		return begin;
+
+	bool overflow = false;
+	const char *it = begin + 1;
+	while (it != end && *it == '=') {
+		const char *num = ++it;
+		uint32_t id = 0;
+		for (; it != end && *it >= '0' && *it <= '9'; ++it) {
+			if (id > (UINT32_MAX - (*it - '0')) / 10)
+				overflow = true;
+			id = id * 10 + (*it - '0');
+		}
+		if (it == num) break;
+		ids.push_back(id);
+	}
+
+	if (it == end || *it != '}' || it[-1] == '=') {
+		ids.clear();
+		return begin;
+	}
+	// Only a block which is otherwise well-formed is an error, as anything
+	// else is just text which happens to start with {=
+	if (overflow)
+		return nullptr;
+	return it + 1;
+}
+
+template<typename Int>
+void append_int(std::string &out, Int v) {
+	char buf[16];
+	char *end = buf + sizeof buf, *p = end;
+	// Negate as unsigned so that INT_MIN works
+	unsigned long long abs = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+	do {
+		*--p = '0' + abs % 10;
+		abs /= 10;
+	} while (abs);
+	if (v < 0) *--p = '-';
+	out.append(p, end);
+}
+
+void append_time(std::string &out, agi::Time time) {
+	// Same as Time::GetAssFormatted() without the temporary string
+	int t = time;
+	char buf[10];
+	buf[0] = '0' + t / 3600000;
+	buf[1] = ':';
+	buf[2] = '0' + (t % (60 * 60 * 1000)) / (60 * 1000 * 10);
+	buf[3] = '0' + (t % (10 * 60 * 1000)) / (60 * 1000);
+	buf[4] = ':';
+	buf[5] = '0' + (t % (60 * 1000)) / (1000 * 10);
+	buf[6] = '0' + (t % (10 * 1000)) / 1000;
+	buf[7] = '.';
+	buf[8] = '0' + (t % 1000) / 100;
+	buf[9] = '0' + (t % 100) / 10;
+	out.append(buf, sizeof buf);
+}
+
+void append_unsafe_str(std::string &out, CharRange str) {
+	auto it = str.begin();
+	while (it != str.end()) {
+		auto comma = std::find(it, str.end(), ',');
+		out.append(it, comma);
+		if (comma == str.end()) break;
+		out += ';';
+		it = comma + 1;
+	}
+}
+}
+
+namespace agi { namespace ass {
+bool ParseDialogue(const char *begin, const char *end, DialogueLine &line) {
+	if (starts_with(begin, end, "Dialogue:", 9)) {
+		line.comment = false;
+		begin += 9;
+	}
+	else if (starts_with(begin, end, "Comment:", 8)) {
+		line.comment = true;
+		begin += 8;
+	}
+	else
+		return false;
+
+	// Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text
+	CharRange fields[9];
+	for (auto& field : fields) {
+		auto comma = static_cast<const char *>(memchr(begin, ',', end - begin));
+		if (!comma) return false;
+		field = CharRange(begin, comma);
+		begin = comma + 1;
+	}
+
+	// The margins are not trimmed, so whitespace around them makes the
+	// line malformed
+	for (int i : {0, 1, 2, 3, 4, 8})
+		fields[i] = trim(fields[i].begin(), fields[i].end());
+
+	auto const& layer = fields[0];
+	if (boost::istarts_with(layer, "marked="))
+		line.layer = 0;
+	else if (!parse_int(layer, line.layer))
+		return false;
+
+	line.start = Time(fields[1].begin(), fields[1].end());
+	line.end = Time(fields[2].begin(), fields[2].end());
+	line.style = fields[3];
+	line.actor = fields[4];
+	for (int i = 0; i < 3; ++i) {
+		int margin;
+		if (!parse_int(fields[5 + i], margin)) return false;
+		line.margin[i] = util::mid(0, margin, 9999);
+	}
+	line.effect = fields[8];
+
+	auto text = parse_extradata(begin, end, line.extradata_ids);
+	if (!text) return false;
+	line.text = CharRange(text, end);
+	return true;
+}
+
+void SerializeDialogue(DialogueLine const& line, std::string &out) {
+	out.reserve(out.size() + 51 + line.style.size() + line.actor.size() + line.effect.size() + line.text.size());
+
+	out += line.comment ? "Comment: " : "Dialogue: ";
+	append_int(out, line.layer);
+	out += ',';
+	append_time(out, line.start);
+	out += ',';
+	append_time(out, line.end);
+	out += ',';
+	append_unsafe_str(out, line.style);
+	out += ',';
+	append_unsafe_str(out, line.actor);
+	out += ',';
+	for (int margin : line.margin) {
+		append_int(out, margin);
+		out += ',';
+	}
+	append_unsafe_str(out, line.effect);
+	out += ',';
+
+	if (!line.extradata_ids.empty()) {
+		out += '{';
+		for (auto id : line.extradata_ids) {
+			out += '=';
+			append_int(out, id);
+		}
+		out += '}';
+	}
+
+	auto it = line.text.begin();
+	while (it != line.text.end()) {
+		auto brk = std::find_if(it, line.text.end(), [](char c) { return c == '\n' || c == '\r'; });
+		out.append(it, brk);
+		if (brk == line.text.end()) break;
+		it = brk + 1;
+	}
+}
+} }
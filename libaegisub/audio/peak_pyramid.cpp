@@ -0,0 +1,216 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/audio/peak_pyramid.h"
+
+#include "libaegisub/io.h"
+#include "libaegisub/log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+namespace {
+using agi::AudioPeakPyramid;
+
+const char peak_file_magic[] = "AGIPEAK1";
+
+struct accumulator {
+	int min = 0;
+	int max = 0;
+	int64_t sum_min = 0;
+	int64_t sum_max = 0;
+	int64_t count = 0;
+
+	void add(AudioPeakPyramid::Peak const& peak, int64_t samples) {
+		min = std::min<int>(min, peak.min);
+		max = std::max<int>(max, peak.max);
+		sum_min += peak.avg_min * samples;
+		sum_max += peak.avg_max * samples;
+		count += samples;
+	}
+
+	AudioPeakPyramid::Peak get() const {
+		if (!count) return AudioPeakPyramid::Peak{0, 0, 0, 0};
+		return AudioPeakPyramid::Peak{
+			static_cast<int16_t>(min), static_cast<int16_t>(max),
+			static_cast<int16_t>(sum_min / count), static_cast<int16_t>(sum_max / count)};
+	}
+};
+}
+
+namespace agi {
+AudioPeakPyramid::AudioPeakPyramid(int64_t num_samples)
+: num_samples(num_samples)
+{
+	int64_t blocks = (num_samples + BlockSize - 1) >> BlockBits;
+	do {
+		levels.emplace_back(std::max<int64_t>(blocks, 1));
+		blocks = (blocks + LevelFactor - 1) >> LevelBits;
+	} while (levels.back().size() > 1);
+}
+
+int64_t AudioPeakPyramid::BlockSamples(size_t level, size_t index) const {
+	const int bits = BlockBits + LevelBits * level;
+	const int64_t start = static_cast<int64_t>(index) << bits;
+	return std::min<int64_t>(int64_t(1) << bits, num_samples - start);
+}
+
+void AudioPeakPyramid::AddSamples(const int16_t *buf, int64_t count) {
+	const int64_t added = ready_samples + pending_count;
+	count = std::min(count, num_samples - added);
+
+	for (int64_t i = 0; i < count; ++i) {
+		const int sample = buf[i];
+		if (sample > 0) {
+			pending_max = std::max(pending_max, sample);
+			pending_sum_max += sample;
+		}
+		else {
+			pending_min = std::min(pending_min, sample);
+			pending_sum_min += sample;
+		}
+
+		if (++pending_count == BlockSize)
+			FinishBlock();
+	}
+
+	if (pending_count && added + count == num_samples)
+		FinishBlock();
+}
+
+void AudioPeakPyramid::FinishBlock() {
+	const int64_t start = ready_samples;
+	const size_t index = start >> BlockBits;
+	levels[0][index] = Peak{
+		static_cast<int16_t>(pending_min), static_cast<int16_t>(pending_max),
+		static_cast<int16_t>(pending_sum_min / pending_count),
+		static_cast<int16_t>(pending_sum_max / pending_count)};
+	Propagate(index);
+
+	// Publish the block only after all of the levels above it are up to date
+	ready_samples = start + pending_count;
+
+	pending_count = 0;
+	pending_min = pending_max = 0;
+	pending_sum_min = pending_sum_max = 0;
+}
+
+void AudioPeakPyramid::Propagate(size_t index) {
+	for (size_t level = 1; level < levels.size(); ++level) {
+		// Parents are only written once all of their children are complete
+		auto const& children = levels[level - 1];
+		if ((index + 1) % LevelFactor != 0 && index + 1 != children.size())
+			return;
+
+		const size_t parent = index >> LevelBits;
+		const size_t first = parent << LevelBits;
+		const size_t last = std::min(first + LevelFactor, children.size());
+
+		accumulator acc;
+		for (size_t i = first; i < last; ++i)
+			acc.add(children[i], BlockSamples(level - 1, i));
+		levels[level][parent] = acc.get();
+
+		index = parent;
+	}
+}
+
+AudioPeakPyramid::Peak AudioPeakPyramid::GetPeak(int64_t start, int64_t end) const {
+	start = std::max<int64_t>(start, 0);
+	end = std::min(end, num_samples);
+	if (start >= end) return Peak{0, 0, 0, 0};
+
+	// Use the coarsest level which still has a block no longer than the
+	// range, so that at most about 2 * LevelFactor blocks are read
+	size_t level = 0;
+	while (level + 1 < levels.size() && (int64_t(1) << (BlockBits + LevelBits * (level + 1))) <= end - start)
+		++level;
+
+	const int64_t ready = ready_samples;
+	accumulator acc;
+
+	// Blocks which straddle the end of the decoded audio have not been
+	// written yet at coarse levels, so fall back to finer levels for them
+	int64_t pos = start;
+	while (pos < end) {
+		size_t lvl = level;
+		int bits = BlockBits + LevelBits * lvl;
+		while (lvl > 0 && ((((pos >> bits) + 1) << bits) > ready && ready < num_samples)) {
+			--lvl;
+			bits -= LevelBits;
+		}
+
+		const size_t index = pos >> bits;
+		if (index >= levels[lvl].size()) break;
+		acc.add(levels[lvl][index], BlockSamples(lvl, index));
+		pos = static_cast<int64_t>(index + 1) << bits;
+	}
+
+	return acc.get();
+}
+
+bool AudioPeakPyramid::Save(fs::path const& file) const {
+	if (ready_samples != num_samples) return false;
+
+	try {
+		io::Save out(file, true);
+		auto& stream = out.Get();
+		stream.write(peak_file_magic, sizeof(peak_file_magic) - 1);
+		stream.write(reinterpret_cast<const char *>(&num_samples), sizeof(num_samples));
+		for (auto const& level : levels)
+			stream.write(reinterpret_cast<const char *>(level.data()), level.size() * sizeof(Peak));
+		out.Close();
+		return true;
+	}
+	catch (agi::Exception const& e) {
+		LOG_E("audio/peak_pyramid") << "Failed to save " << file << ": " << e.GetMessage();
+		return false;
+	}
+}
+
+bool AudioPeakPyramid::Load(fs::path const& file) {
+	if (ready_samples || pending_count) return false;
+
+	try {
+		auto stream = io::Open(file, true);
+
+		char magic[sizeof(peak_file_magic) - 1];
+		int64_t file_samples = 0;
+		stream->read(magic, sizeof(magic));
+		stream->read(reinterpret_cast<char *>(&file_samples), sizeof(file_samples));
+		if (!stream->good() || memcmp(magic, peak_file_magic, sizeof(magic)) || file_samples != num_samples)
+			return false;
+
+		for (auto& level : levels) {
+			stream->read(reinterpret_cast<char *>(level.data()), level.size() * sizeof(Peak));
+			if (!stream->good()) {
+				for (auto& l : levels)
+					std::fill(l.begin(), l.end(), Peak{0, 0, 0, 0});
+				return false;
+			}
+		}
+	}
+	catch (agi::Exception const& e) {
+		LOG_D("audio/peak_pyramid") << "Failed to load " << file << ": " << e.GetMessage();
+		return false;
+	}
+
+	ready_samples = num_samples;
+	return true;
+}
+}
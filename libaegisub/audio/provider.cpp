@@ -16,6 +16,7 @@
 
 #include "libaegisub/audio/provider.h"
 
+#include "libaegisub/audio/peak_pyramid.h"
 #include "libaegisub/fs.h"
 #include "libaegisub/io.h"
 #include "libaegisub/log.h"
@@ -80,6 +81,11 @@ void AudioProvider::FillBufferInt16Mono(int16_t* buf, int64_t start, int64_t cou
 	}
 	void* buff = malloc(bytes_per_sample * count * channels);
 	FillBuffer(buff, start, count);
+	ConvertToInt16Mono(buff, buf, count);
+	free(buff);
+}
+
+void AudioProvider::ConvertToInt16Mono(void *buff, int16_t *buf, int64_t count) const {
 	if (channels == 1) {
 		if (float_samples) {
 			if (bytes_per_sample == sizeof(float))
@@ -116,7 +122,17 @@ void AudioProvider::FillBufferInt16Mono(int16_t* buf, int64_t start, int64_t cou
 					buf[i] = DownmixToMono<ConvertIntToInt16>(ConvertIntToInt16(buff, bytes_per_sample), channels)[i];
 		}
 	}
-	free(buff);
+}
+
+void AudioProvider::AddToPeakPyramid(AudioPeakPyramid &peaks, void *buf, int64_t count) const {
+	if (!float_samples && bytes_per_sample == 2 && channels == 1) {
+		peaks.AddSamples(static_cast<int16_t *>(buf), count);
+		return;
+	}
+
+	std::vector<int16_t> mono(count);
+	ConvertToInt16Mono(buf, mono.data(), count);
+	peaks.AddSamples(mono.data(), count);
 }
 
 void AudioProvider::GetInt16MonoAudioWithVolume(int16_t *buf, int64_t start, int64_t count, double volume) const {
@@ -16,6 +16,7 @@
 
 #include "libaegisub/audio/provider.h"
 
+#include <libaegisub/audio/peak_pyramid.h>
 #include <libaegisub/file_mapping.h>
 #include <libaegisub/format.h>
 #include <libaegisub/fs.h>
@@ -32,6 +33,9 @@ using namespace agi;
 
 class HDAudioProvider final : public AudioProviderWrapper {
 	mutable temp_file_mapping file;
+	AudioPeakPyramid peaks;
+	fs::path peak_cache;
+	bool save_peaks = false;
 	std::atomic<bool> cancelled = {false};
 	std::thread decoder;
 
@@ -59,17 +63,25 @@ class HDAudioProvider final : public AudioProviderWrapper {
 	}
 
 public:
-	HDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir)
+	HDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir, agi::fs::path const& peak_cache)
 	: AudioProviderWrapper(std::move(src))
 	, file(dir / CacheFilename(dir), num_samples * bytes_per_sample* channels)
+	, peaks(num_samples)
+	, peak_cache(peak_cache)
 	{
 		decoded_samples = 0;
-		decoder = std::thread([&] {
+		const bool build_peaks = peak_cache.empty() || !peaks.Load(peak_cache);
+		save_peaks = build_peaks && !peak_cache.empty();
+
+		decoder = std::thread([=] {
 			int64_t block = 65536;
 			for (int64_t i = 0; i < num_samples; i += block) {
 				if (cancelled) break;
 				block = std::min(block, num_samples - i);
-				source->GetAudio(file.write(i * bytes_per_sample * channels, block * bytes_per_sample * channels), i, block);
+				auto buf = file.write(i * bytes_per_sample * channels, block * bytes_per_sample * channels);
+				source->GetAudio(buf, i, block);
+				if (build_peaks)
+					AddToPeakPyramid(peaks, buf, block);
 				decoded_samples += block;
 			}
 		});
@@ -78,12 +90,20 @@ public:
 	~HDAudioProvider() {
 		cancelled = true;
 		decoder.join();
+		if (save_peaks)
+			peaks.Save(peak_cache);
 	}
+
+	AudioPeakPyramid const* GetPeakPyramid() const override { return &peaks; }
 };
 }
 
 namespace agi {
 std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir) {
-	return agi::make_unique<HDAudioProvider>(std::move(src), dir);
+	return agi::make_unique<HDAudioProvider>(std::move(src), dir, agi::fs::path());
+}
+
+std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir, agi::fs::path const& peak_cache) {
+	return agi::make_unique<HDAudioProvider>(std::move(src), dir, peak_cache);
 }
 }
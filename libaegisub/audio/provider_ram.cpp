@@ -16,6 +16,8 @@
 
 #include "libaegisub/audio/provider.h"
 
+#include "libaegisub/audio/peak_pyramid.h"
+#include "libaegisub/fs.h"
 #include "libaegisub/make_unique.h"
 
 #include <array>
@@ -34,16 +36,23 @@ class RAMAudioProvider final : public AudioProviderWrapper {
 #else
 	boost::container::stable_vector<std::array<char, CacheBlockSize>> blockcache;
 #endif
+	AudioPeakPyramid peaks;
+	fs::path peak_cache;
+	bool save_peaks = false;
 	std::atomic<bool> cancelled = {false};
 	std::thread decoder;
 
 	void FillBuffer(void *buf, int64_t start, int64_t count) const override;
 
 public:
-	RAMAudioProvider(std::unique_ptr<AudioProvider> src)
+	RAMAudioProvider(std::unique_ptr<AudioProvider> src, fs::path const& peak_cache)
 	: AudioProviderWrapper(std::move(src))
+	, peaks(num_samples)
+	, peak_cache(peak_cache)
 	{
 		decoded_samples = 0;
+		const bool build_peaks = peak_cache.empty() || !peaks.Load(peak_cache);
+		save_peaks = build_peaks && !peak_cache.empty();
 
 		try {
 			blockcache.resize((num_samples * bytes_per_sample * channels + CacheBlockSize - 1) >> CacheBits);
@@ -52,12 +61,14 @@ public:
 			throw AudioProviderError("Not enough memory available to cache in RAM");
 		}
 
-		decoder = std::thread([&] {
+		decoder = std::thread([=] {
 			int64_t readsize = CacheBlockSize / bytes_per_sample / channels;
 			for (size_t i = 0; i < blockcache.size(); i++) {
 				if (cancelled) break;
 				auto actual_read = std::min<int64_t>(readsize, num_samples - i * readsize);
 				source->GetAudio(&blockcache[i][0], i * readsize, actual_read);
+				if (build_peaks)
+					AddToPeakPyramid(peaks, &blockcache[i][0], actual_read);
 				decoded_samples += actual_read;
 			}
 		});
@@ -66,7 +77,11 @@ public:
 	~RAMAudioProvider() {
 		cancelled = true;
 		decoder.join();
+		if (save_peaks)
+			peaks.Save(peak_cache);
 	}
+
+	AudioPeakPyramid const* GetPeakPyramid() const override { return &peaks; }
 };
 
 void RAMAudioProvider::FillBuffer(void *buf, int64_t start, int64_t count) const {
@@ -93,6 +108,10 @@ void RAMAudioProvider::FillBuffer(void *buf, int64_t start, int64_t count) const
 
 namespace agi {
 std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> src) {
-	return agi::make_unique<RAMAudioProvider>(std::move(src));
+	return agi::make_unique<RAMAudioProvider>(std::move(src), fs::path());
+}
+
+std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> src, fs::path const& peak_cache) {
+	return agi::make_unique<RAMAudioProvider>(std::move(src), peak_cache);
 }
 }
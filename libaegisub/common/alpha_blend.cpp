@@ -0,0 +1,114 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/alpha_blend.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BLEND_SSE2
+#endif
+
+namespace {
+/// x / 255 rounded down, exact for x in [0, 65025]
+inline unsigned div255(unsigned x) {
+	return ((x + 1) * 257) >> 16;
+}
+
+void blend_row_scalar(uint8_t *dst, const uint8_t *mask, int width, unsigned b, unsigned g, unsigned r, unsigned opacity) {
+	for (int x = 0; x < width; ++x, dst += 4) {
+		if (!mask[x]) continue;
+
+		unsigned k = div255(mask[x] * opacity);
+		unsigned ck = 255 - k;
+		dst[0] = div255(k * b + ck * dst[0]);
+		dst[1] = div255(k * g + ck * dst[1]);
+		dst[2] = div255(k * r + ck * dst[2]);
+		dst[3] = 0;
+	}
+}
+
+#ifdef BLEND_SSE2
+/// Blend two pixels which have been widened to 16 bits per channel
+/// @param k Coverage of each pixel, repeated for each channel
+inline __m128i blend_pixels(__m128i px, __m128i k, __m128i color) {
+	const __m128i c255 = _mm_set1_epi16(255);
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i c257 = _mm_set1_epi16(257);
+
+	__m128i sum = _mm_add_epi16(_mm_mullo_epi16(k, color), _mm_mullo_epi16(_mm_sub_epi16(c255, k), px));
+	return _mm_mulhi_epu16(_mm_add_epi16(sum, one), c257);
+}
+
+void blend_row_sse2(uint8_t *dst, const uint8_t *mask, int width, unsigned b, unsigned g, unsigned r, unsigned opacity) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i c257 = _mm_set1_epi16(257);
+	const __m128i op = _mm_set1_epi16(opacity);
+	const __m128i color = _mm_setr_epi16(b, g, r, 0, b, g, r, 0);
+	const __m128i no_alpha = _mm_set1_epi32(0x00FFFFFF);
+
+	int x = 0;
+	for (; x + 8 <= width; x += 8, dst += 32) {
+		uint64_t m;
+		memcpy(&m, mask + x, sizeof m);
+		// Glyph bitmaps are mostly empty space, so skip over it quickly
+		if (!m) continue;
+
+		__m128i k = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(mask + x)), zero);
+		k = _mm_mulhi_epu16(_mm_add_epi16(_mm_mullo_epi16(k, op), one), c257);
+
+		__m128i k03 = _mm_unpacklo_epi16(k, k);
+		__m128i k47 = _mm_unpackhi_epi16(k, k);
+
+		__m128i *out = reinterpret_cast<__m128i *>(dst);
+		__m128i lo = _mm_loadu_si128(out);
+		__m128i hi = _mm_loadu_si128(out + 1);
+
+		lo = _mm_packus_epi16(
+			blend_pixels(_mm_unpacklo_epi8(lo, zero), _mm_unpacklo_epi32(k03, k03), color),
+			blend_pixels(_mm_unpackhi_epi8(lo, zero), _mm_unpackhi_epi32(k03, k03), color));
+		hi = _mm_packus_epi16(
+			blend_pixels(_mm_unpacklo_epi8(hi, zero), _mm_unpacklo_epi32(k47, k47), color),
+			blend_pixels(_mm_unpackhi_epi8(hi, zero), _mm_unpackhi_epi32(k47, k47), color));
+
+		_mm_storeu_si128(out, _mm_and_si128(lo, no_alpha));
+		_mm_storeu_si128(out + 1, _mm_and_si128(hi, no_alpha));
+	}
+
+	blend_row_scalar(dst, mask + x, width - x, b, g, r, opacity);
+}
+#endif
+}
+
+namespace agi {
+void BlendMask(uint8_t *dst, ptrdiff_t dst_stride, const uint8_t *mask, ptrdiff_t mask_stride, int width, int height, uint32_t color) {
+	const unsigned opacity = 255 - (color & 0xFF);
+	const unsigned r = color >> 24;
+	const unsigned g = (color >> 16) & 0xFF;
+	const unsigned b = (color >> 8) & 0xFF;
+	if (!opacity) return;
+
+	for (int y = 0; y < height; ++y, dst += dst_stride, mask += mask_stride) {
+#ifdef BLEND_SSE2
+		blend_row_sse2(dst, mask, width, b, g, r, opacity);
+#else
+		blend_row_scalar(dst, mask, width, b, g, r, opacity);
+#endif
+	}
+}
+}
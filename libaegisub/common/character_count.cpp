@@ -22,9 +22,16 @@
 #include <unicode/uchar.h>
 #include <unicode/utf8.h>
 
-#include <mutex>
+#include <array>
+#include <cstdint>
+#include <cstring>
 #include <unicode/brkiter.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COUNT_SSE2
+#endif
+
 namespace {
 struct utext_deleter {
 	void operator()(UText *ut) { if (ut) utext_close(ut); }
@@ -34,13 +41,14 @@ using utext_ptr = std::unique_ptr<UText, utext_deleter>;
 UChar32 ass_special_chars[] = {'n', 'N', 'h'};
 
 icu::BreakIterator& get_break_iterator(const char *ptr, size_t len) {
-	static std::unique_ptr<icu::BreakIterator> bi;
-	static std::once_flag token;
-	std::call_once(token, [&] {
+	// Break iterators hold the text being iterated over, so each thread
+	// needs its own
+	static thread_local std::unique_ptr<icu::BreakIterator> bi;
+	if (!bi) {
 		UErrorCode status = U_ZERO_ERROR;
 		bi.reset(icu::BreakIterator::createCharacterInstance(icu::Locale::getDefault(), status));
 		if (U_FAILURE(status)) throw agi::InternalError("Failed to create character iterator");
-	});
+	}
 
 	UErrorCode err = U_ZERO_ERROR;
 	utext_ptr ut(utext_openUTF8(nullptr, ptr, len, &err));
@@ -52,13 +60,98 @@ icu::BreakIterator& get_break_iterator(const char *ptr, size_t len) {
 	return *bi;
 }
 
+bool is_ascii(const char *str, size_t len) {
+	size_t i = 0;
+	uint8_t bits = 0;
+#ifdef COUNT_SSE2
+	__m128i wide_bits = _mm_setzero_si128();
+	for (; i + 16 <= len; i += 16)
+		wide_bits = _mm_or_si128(wide_bits, _mm_loadu_si128(reinterpret_cast<const __m128i *>(str + i)));
+	if (_mm_movemask_epi8(wide_bits))
+		return false;
+#endif
+	for (; i < len; ++i)
+		bits |= static_cast<uint8_t>(str[i]);
+	return !(bits & 0x80);
+}
+
+/// General category masks of the code points below U+0300. None of these
+/// combine with their neighbours, so every one of them other than the LF
+/// of a CR LF pair is a grapheme cluster of its own.
+int32_t const* latin_gc_masks() {
+	static const std::array<int32_t, 0x300> masks = [] {
+		std::array<int32_t, 0x300> masks;
+		for (UChar32 c = 0; c < 0x300; ++c)
+			masks[c] = U_GET_GC_MASK(c);
+		return masks;
+	}();
+	return masks.data();
+}
+
+/// Count the grapheme clusters in text made up entirely of code points
+/// below U+0300 without going through ICU
+/// @return false if the text has anything else in it, in which case count
+///         is unset
+bool count_latin(const char *str, size_t len, int mask, size_t& count) {
+	if (!mask && is_ascii(str, len)) {
+		count = len;
+		for (auto cr = str; (cr = static_cast<const char *>(memchr(cr, '\r', str + len - cr))); ) {
+			if (++cr < str + len && *cr == '\n')
+				--count;
+		}
+		return true;
+	}
+
+	auto gc_masks = latin_gc_masks();
+	count = 0;
+	UChar32 prev = 0;
+	for (size_t i = 0; i < len; ) {
+		size_t start = i;
+		auto lead = static_cast<uint8_t>(str[i]);
+		UChar32 c;
+		if (lead < 0x80) {
+			c = lead;
+			++i;
+		}
+		else if (lead >= 0xC2 && lead < 0xCC && i + 1 < len && (str[i + 1] & 0xC0) == 0x80) {
+			c = ((lead & 0x1F) << 6) | (str[i + 1] & 0x3F);
+			i += 2;
+		}
+		else
+			return false;
+
+		// Same logic as count_in_range, with each code point being a cluster
+		if ((gc_masks[c] & mask) == 0) {
+			if (mask & U_GC_Z_MASK && start != 0 && std::find(std::begin(ass_special_chars), std::end(ass_special_chars), c) != std::end(ass_special_chars)) {
+				if (prev != (UChar32) '\\')
+					++count;
+				else if (!(mask & U_GC_P_MASK))
+					--count;
+			}
+			else
+				++count;
+		}
+
+		prev = c;
+		if (c == '\r' && i < len && str[i] == '\n') {
+			prev = '\n';
+			++i;
+		}
+	}
+	return true;
+}
+
 template <typename Iterator>
 size_t count_in_range(Iterator begin, Iterator end, int mask) {
 	if (begin == end) return 0;
 
+	size_t count = 0;
+	if (count_latin(&*begin, end - begin, mask, count))
+		return count;
+
 	auto& character_bi = get_break_iterator(&*begin, end - begin);
 
-	size_t count = 0;
+	count = 0;
 	auto pos = character_bi.first();
 	for (auto end = character_bi.next(); end != icu::BreakIterator::DONE; pos = end, end = character_bi.next()) {
 		if (!mask)
@@ -307,20 +307,25 @@ std::string IconvWrapper::Convert(const char *source, size_t len) {
 }
 
 void IconvWrapper::Convert(const char *src, size_t srcLen, std::string &dest) {
-	char buff[512];
-
+	// Convert directly into dest, sized so that converting a large block of
+	// text usually only takes one call to iconv
+	size_t used = dest.size();
 	size_t res;
+	int err;
 	do {
-		char *dst = buff;
-		size_t dstLen = sizeof(buff);
+		dest.resize(used + srcLen * 2 + 16);
+		char *dst = &dest[used];
+		size_t dstLen = dest.size() - used;
 		res = conv->Convert(&src, &srcLen, &dst, &dstLen);
+		err = errno;
 		if (res == 0) conv->Convert(nullptr, nullptr, &dst, &dstLen);
 
-		dest.append(buff, sizeof(buff) - dstLen);
-	} while (res == iconv_failed && errno == E2BIG);
+		used = dest.size() - dstLen;
+	} while (res == iconv_failed && err == E2BIG);
+	dest.resize(used);
 
 	if (res == iconv_failed) {
-		switch (errno) {
+		switch (err) {
 			case EILSEQ:
 			case EINVAL:
 				throw BadInput(
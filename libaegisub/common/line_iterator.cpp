@@ -16,65 +16,167 @@
 #include <libaegisub/charset_conv.h>
 
 #include <boost/algorithm/string/case_conv.hpp>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+/// Number of bytes read from the stream at a time when decoding
+const std::streamsize block_size = 65536;
+}
 
 namespace agi {
 
-line_iterator_base::line_iterator_base(std::istream &stream, std::string encoding)
-: stream(&stream)
-{
-	std::string encoding_lower{ encoding };
-	boost::to_lower(encoding_lower);
-	if (encoding_lower != "utf-8") {
+struct line_iterator_base::block_decoder {
+	charset::IconvWrapper conv;
+	int lf = '\n'; ///< LF character in the source encoding
+	size_t width = 1;  ///< width of LF character in the source encoding
+
+	/// Bytes read from the stream which haven't been decoded yet. Always
+	/// starts at the beginning of a line.
+	std::string raw;
+	/// Decoded text which hasn't been returned yet, starting at pos
+	std::string text;
+	size_t pos = 0;
+
+	bool started = false; ///< Has anything been read yet?
+	bool eof = false;     ///< Has all of the stream been read?
+	bool done = false;    ///< Has the last line been returned?
+
+	block_decoder(std::string const& encoding)
+	: conv(encoding.c_str(), "utf-8")
+	{
 		agi::charset::IconvWrapper c("utf-8", encoding.c_str());
-		c.Convert("\r", 1, reinterpret_cast<char *>(&cr), sizeof(int));
 		c.Convert("\n", 1, reinterpret_cast<char *>(&lf), sizeof(int));
 		width = c.RequiredBufferSize("\n");
-		conv = std::make_shared<agi::charset::IconvWrapper>(encoding.c_str(), "utf-8");
 	}
-}
 
-bool line_iterator_base::getline(std::string &str) {
-	if (!stream) return false;
-	if (!stream->good()) {
-		stream = nullptr;
-		return false;
+	/// Find the end of the last complete line in raw, searching only the
+	/// bytes from start onwards
+	/// @return Offset just past the last LF, or 0 if there isn't one
+	size_t last_line_end(size_t start) const {
+		size_t end = raw.size() - raw.size() % width;
+		start -= start % width;
+		for (; end > start; end -= width) {
+			if (!memcmp(&raw[end - width], &lf, width))
+				return end;
+		}
+		return 0;
 	}
 
-	if (width == 1) {
-		std::getline(*stream, str);
-		if (str.size() && str.back() == '\r')
-			str.pop_back();
+	/// Convert the first len bytes of raw, which must end at a character
+	/// boundary, and append them to text
+	void decode(size_t len) {
+		const char *in = raw.data();
+		size_t in_left = len;
+		size_t used = text.size();
+		for (;;) {
+			// No supported encoding takes more than three bytes of UTF-8 per
+			// byte of input, so this normally takes a single iconv call
+			text.resize(used + in_left * 3 + 16);
+			char *out = &text[used];
+			size_t out_left = text.size() - used;
+			size_t res = conv.Convert(&in, &in_left, &out, &out_left);
+			int err = errno;
+			used = text.size() - out_left;
+			if (res != (size_t)-1)
+				break;
+			if (err != E2BIG) {
+				text.resize(used);
+				throw charset::BadInput(
+					"One or more characters in the input string were not valid "
+					"characters in the given input encoding");
+			}
+		}
+		text.resize(used);
+		raw.erase(0, len);
 	}
-	else {
-		union {
-			int32_t chr;
-			char buf[4];
-		} u;
+
+	/// Read and decode at least one more complete line, or the rest of the
+	/// stream if there are no more line breaks
+	void fill(std::istream &stream) {
+		text.erase(0, pos);
+		pos = 0;
+
+		// Lines are split in the source encoding before decoding so that
+		// iconv is never given a partial character, which some
+		// implementations silently drop rather than reporting
+		size_t line_end = 0;
+		while (!eof && !line_end) {
+			size_t start = raw.size();
+			raw.resize(start + block_size);
+			std::streamsize read = stream.rdbuf()->sgetn(&raw[start], block_size);
+			raw.resize(start + static_cast<size_t>(read));
+			if (read < block_size) {
+				stream.setstate(std::ios::eofbit);
+				eof = true;
+			}
+			line_end = last_line_end(start);
+		}
+
+		decode(eof ? raw.size() : line_end);
+	}
+
+	bool getline(std::istream &stream, std::string &str) {
+		if (done) return false;
+		if (!started) {
+			started = true;
+			if (!stream.good()) {
+				done = true;
+				return false;
+			}
+		}
 
 		for (;;) {
-			u.chr = 0;
-			std::streamsize read = stream->rdbuf()->sgetn(u.buf, width);
-			if (read < (std::streamsize)width) {
-				for (int i = 0; i < read; i++) {
-					str += u.buf[i];
-				}
-				stream->setstate(std::ios::eofbit);
+			size_t end = text.find('\n', pos);
+			if (end != std::string::npos) {
+				str.assign(text, pos, end - pos);
+				pos = end + 1;
 				break;
 			}
-			if (u.chr == cr) continue;
-			if (u.chr == lf) break;
-			for (int i = 0; i < read; i++) {
-				str += u.buf[i];
+			if (eof) {
+				str.assign(text, pos, std::string::npos);
+				pos = text.size();
+				done = true;
+				break;
 			}
+			fill(stream);
+		}
+
+		if (str.size() && str.back() == '\r')
+			str.pop_back();
+		return true;
+	}
+};
+
+line_iterator_base::line_iterator_base(std::istream &stream, std::string encoding)
+: stream(&stream)
+{
+	std::string encoding_lower{ encoding };
+	boost::to_lower(encoding_lower);
+	if (encoding_lower != "utf-8")
+		decoder = std::make_shared<block_decoder>(encoding);
+}
+
+bool line_iterator_base::getline(std::string &str) {
+	if (!stream) return false;
+
+	if (decoder) {
+		if (!decoder->getline(*stream, str)) {
+			stream = nullptr;
+			return false;
 		}
+		return true;
 	}
 
-	if (conv.get()) {
-		std::string tmp;
-		conv->Convert(str, tmp);
-		str = std::move(tmp);
+	if (!stream->good()) {
+		stream = nullptr;
+		return false;
 	}
 
+	std::getline(*stream, str);
+	if (str.size() && str.back() == '\r')
+		str.pop_back();
+
 	return true;
 }
 }
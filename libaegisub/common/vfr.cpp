@@ -176,16 +176,25 @@ Framerate::Framerate(fs::path const& filename)
 {
 	auto file = agi::io::Open(filename);
 	auto encoding = agi::charset::Detect(filename);
-	auto line = *line_iterator<std::string>(*file, encoding);
+
+	// line_iterator may read ahead, so all of the file has to be read
+	// through a single one
+	line_iterator<std::string> lines(*file, encoding);
+	auto line = *lines;
 	if (line == "# timecode format v2") {
-		copy(line_iterator<int>(*file, encoding), line_iterator<int>(), back_inserter(timecodes));
+		while (++lines != line_iterator<std::string>()) {
+			boost::interprocess::ibufferstream ss(lines->data(), lines->size());
+			int time;
+			if (ss >> time)
+				timecodes.push_back(time);
+		}
 		SetFromTimecodes();
 		return;
 	}
 	if (line == "# timecode format v1" || line.substr(0, 7) == "Assume ") {
 		if (line[0] == '#')
-			line = *line_iterator<std::string>(*file, encoding);
-		numerator = v1_parse(line_iterator<std::string>(*file, encoding), line, timecodes, last);
+			line = *++lines;
+		numerator = v1_parse(++lines, line, timecodes, last);
 		return;
 	}
 
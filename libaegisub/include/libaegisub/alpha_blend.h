@@ -0,0 +1,37 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace agi {
+/// @brief Blend a solid colour through an 8-bit coverage mask onto BGRA pixels
+/// @param dst        Top-left pixel of the destination
+/// @param dst_stride Distance in bytes between rows of dst
+/// @param mask       Top-left byte of the coverage mask
+/// @param mask_stride Distance in bytes between rows of mask
+/// @param width      Width in pixels of the area to blend
+/// @param height     Height in pixels of the area to blend
+/// @param color      Colour in libass's RGBT format, i.e. 0xRRGGBBTT where TT is transparency
+///
+/// Each pixel becomes (k * color + (255 - k) * dst) / 255, where k is
+/// mask * (255 - TT) / 255, using truncating integer division throughout.
+/// The alpha channel of pixels with any coverage is set to zero, and pixels
+/// with no coverage may be left untouched.
+void BlendMask(uint8_t *dst, ptrdiff_t dst_stride, const uint8_t *mask, ptrdiff_t mask_stride, int width, int height, uint32_t color);
+}
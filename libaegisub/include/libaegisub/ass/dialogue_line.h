@@ -0,0 +1,66 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <libaegisub/ass/time.h>
+
+#include <boost/range/iterator_range.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace agi { namespace ass {
+typedef boost::iterator_range<const char *> CharRange;
+
+/// The fields of a Dialogue or Comment line
+///
+/// The string fields point into the buffer which was parsed or which is
+/// being serialized, so a DialogueLine must not outlive it. Reusing a
+/// single DialogueLine for many lines avoids all allocation once
+/// extradata_ids has grown to the largest list seen.
+struct DialogueLine {
+	bool comment = false;
+	int layer = 0;
+	Time start;
+	Time end;
+	CharRange style;
+	CharRange actor;
+	int margin[3] = {0, 0, 0};
+	CharRange effect;
+	/// Extradata ids from the {=1=2} block at the start of the text
+	std::vector<uint32_t> extradata_ids;
+	/// Text with the extradata block removed
+	CharRange text;
+};
+
+/// @brief Split a Dialogue or Comment line into its fields
+/// @param begin Start of the line, which must not include the line break
+/// @param end   End of the line
+/// @param[out] line Parsed fields
+/// @return false if the line is not a well-formed dialogue line
+///
+/// SSA-style "Marked=" lines are accepted and get layer 0. Whitespace
+/// around the margins and an extradata block with an id which does not
+/// fit in 32 bits make the line malformed.
+bool ParseDialogue(const char *begin, const char *end, DialogueLine &line);
+
+/// @brief Append a line in ASS format to out
+///
+/// Commas in the style, actor and effect are replaced with semicolons,
+/// and line breaks in the text are dropped.
+void SerializeDialogue(DialogueLine const& line, std::string &out);
+} }
@@ -26,6 +26,8 @@ class Time {
 public:
 	Time(int ms = 0);
 	Time(std::string const& text);
+	/// Parse the time in [begin, end) without copying it into a string
+	Time(const char *begin, const char *end);
 
 	/// Get millisecond, rounded to centisecond precision
 	// Always round up for 5ms because the range is [start, stop)
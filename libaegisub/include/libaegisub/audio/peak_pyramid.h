@@ -0,0 +1,105 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <libaegisub/fs_fwd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace agi {
+/// @class AudioPeakPyramid
+/// @brief Multi-resolution min/max/average summary of 16-bit mono audio
+///
+/// Level 0 summarises blocks of BlockSize samples, and each following level
+/// summarises LevelFactor blocks of the level below it, so a range of any
+/// length can be summarised by reading a handful of entries. Samples must be
+/// added in order from the start of the stream, and the summary may be read
+/// from other threads while it is being built.
+class AudioPeakPyramid {
+public:
+	/// log2 of the number of samples in a level 0 block
+	static const int BlockBits = 8;
+	static const int64_t BlockSize = 1 << BlockBits;
+	/// log2 of the number of blocks merged into each block of the next level
+	static const int LevelBits = 2;
+	static const int LevelFactor = 1 << LevelBits;
+
+	/// Summary of a range of samples
+	struct Peak {
+		/// Lowest non-positive sample, or 0
+		int16_t min;
+		/// Highest positive sample, or 0
+		int16_t max;
+		/// Sum of the non-positive samples divided by the number of samples
+		int16_t avg_min;
+		/// Sum of the positive samples divided by the number of samples
+		int16_t avg_max;
+	};
+
+private:
+	int64_t num_samples;
+	/// Blocks for each level, finest first
+	std::vector<std::vector<Peak>> levels;
+	/// Number of samples covered by completed level 0 blocks
+	std::atomic<int64_t> ready_samples{0};
+
+	/// Accumulator for the level 0 block currently being filled
+	int64_t pending_count = 0;
+	int pending_min = 0;
+	int pending_max = 0;
+	int64_t pending_sum_min = 0;
+	int64_t pending_sum_max = 0;
+
+	int64_t BlockSamples(size_t level, size_t index) const;
+	void FinishBlock();
+	void Propagate(size_t index);
+
+public:
+	/// @param num_samples Total number of samples in the stream being summarised
+	AudioPeakPyramid(int64_t num_samples);
+
+	/// Append samples to the summary
+	/// @param buf Samples following those previously added
+	/// @param count Number of samples in buf
+	void AddSamples(const int16_t *buf, int64_t count);
+
+	/// Number of samples from the start of the stream which can be queried
+	int64_t GetReadySamples() const { return ready_samples; }
+	int64_t GetNumSamples() const { return num_samples; }
+
+	/// Summarise the samples in [start, end)
+	///
+	/// The range is widened to block boundaries of the level used, so the
+	/// result is approximate for ranges much shorter than BlockSize. The
+	/// range must not extend past GetReadySamples() unless it extends past
+	/// the end of the stream.
+	Peak GetPeak(int64_t start, int64_t end) const;
+
+	/// Write a completed summary to a file
+	/// @return Whether the summary was complete and was written successfully
+	bool Save(fs::path const& file) const;
+
+	/// Read a summary previously written with Save()
+	///
+	/// Must be called before any samples are added. The file is ignored if it
+	/// is unreadable or was written for a stream of a different length.
+	/// @return Whether the summary was loaded, in which case it is complete
+	bool Load(fs::path const& file);
+};
+}
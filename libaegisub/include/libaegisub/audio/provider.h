@@ -23,6 +23,8 @@
 #include <vector>
 
 namespace agi {
+class AudioPeakPyramid;
+
 class AudioProvider {
 protected:
 	int channels = 0;
@@ -40,6 +42,12 @@ protected:
 
 	void ZeroFill(void *buf, int64_t count) const;
 
+	/// Convert samples in this provider's format to 16-bit mono
+	void ConvertToInt16Mono(void *src, int16_t *dst, int64_t count) const;
+
+	/// Add a block of samples in this provider's format to a peak summary
+	void AddToPeakPyramid(AudioPeakPyramid &peaks, void *buf, int64_t count) const;
+
 public:
 	virtual ~AudioProvider() = default;
 
@@ -56,6 +64,10 @@ public:
 
 	/// Does this provider benefit from external caching?
 	virtual bool NeedsCache() const { return false; }
+
+	/// Get a min/max/average summary of the audio for rendering
+	/// @return The summary, or nullptr if this provider does not build one
+	virtual AudioPeakPyramid const* GetPeakPyramid() const { return nullptr; }
 };
 
 /// Helper base class for an audio provider which wraps another provider
@@ -93,5 +105,11 @@ std::unique_ptr<AudioProvider> CreateLockAudioProvider(std::unique_ptr<AudioProv
 std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> source_provider, fs::path const& dir);
 std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> source_provider);
 
+/// Create a caching provider which reuses a peak summary saved by a previous
+/// session from peak_cache if possible, and otherwise saves the summary it
+/// builds there once all of the audio has been decoded
+std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> source_provider, fs::path const& dir, fs::path const& peak_cache);
+std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> source_provider, fs::path const& peak_cache);
+
 void SaveAudioClip(AudioProvider const& provider, fs::path const& path, int start_time, int end_time);
 }
@@ -26,14 +26,13 @@
 
 namespace agi {
 
-namespace charset { class IconvWrapper; }
-
 class line_iterator_base {
 	std::istream *stream = nullptr; ///< Stream to iterate over
-	std::shared_ptr<agi::charset::IconvWrapper> conv;
-	int cr = '\r'; ///< CR character in the source encoding
-	int lf = '\n'; ///< LF character in the source encoding
-	size_t width = 1;  ///< width of LF character in the source encoding
+
+	/// Decoder for encodings other than UTF-8, which reads and converts the
+	/// stream a block at a time. Shared by copies of an iterator.
+	struct block_decoder;
+	std::shared_ptr<block_decoder> decoder;
 
 protected:
 	bool getline(std::string &str);
@@ -74,6 +73,10 @@ public:
 	///               for ensuring that the stream remains valid for the
 	///               lifetime of the iterator and that it get cleaned up.
 	/// @param encoding Encoding of the text read from the stream
+	///
+	/// For encodings other than UTF-8 the stream is read ahead of the current
+	/// line, so it should not be read from other than through this iterator
+	/// (and its copies) until the iterator reaches the end.
 	line_iterator(std::istream &stream, std::string encoding = "utf-8")
 	: line_iterator_base(stream, std::move(encoding))
 	{
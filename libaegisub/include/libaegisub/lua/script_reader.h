@@ -26,4 +26,8 @@ namespace agi { namespace lua {
 	/// Install our module loader and add include_path to the module search
 	/// path of the given lua state
 	bool Install(lua_State *L, std::vector<fs::path> const& include_path);
+	/// Cache the compiled form of scripts loaded with LoadFile in the given
+	/// directory, and load unmodified scripts from there rather than
+	/// compiling them again
+	void EnableBytecodeCache(lua_State *L, fs::path const& cache_dir);
 } }
@@ -17,12 +17,173 @@
 #include "libaegisub/lua/script_reader.h"
 
 #include "libaegisub/file_mapping.h"
+#include "libaegisub/io.h"
 #include "libaegisub/log.h"
 #include "libaegisub/lua/utils.h"
 #include "libaegisub/split.h"
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/crc.hpp>
+#include <cstring>
 #include <lauxlib.h>
+#include <luajit.h>
+
+namespace {
+	using namespace agi::lua;
+
+	const char cache_magic[] = "AGILUAC1";
+
+	/// Get the path the compiled form of a script should be cached at, or an
+	/// empty path if caching isn't enabled for this lua state
+	agi::fs::path cache_path(lua_State *L, agi::fs::path const& filename, size_t size) {
+		lua_getfield(L, LUA_REGISTRYINDEX, "bytecode cache");
+		if (!lua_isstring(L, -1)) {
+			lua_pop(L, 1);
+			return agi::fs::path();
+		}
+		agi::fs::path dir = lua_tostring(L, -1);
+		lua_pop(L, 1);
+
+		boost::crc_32_type hash;
+		hash.process_bytes(filename.string().c_str(), filename.string().size());
+
+		time_t mtime;
+		try {
+			mtime = agi::fs::ModifiedTime(filename);
+		}
+		catch (agi::Exception const&) {
+			return agi::fs::path();
+		}
+
+		return dir/(std::to_string(hash.checksum()) + "_" + std::to_string(size) + "_" + std::to_string(mtime) + ".luac");
+	}
+
+	template<typename T>
+	void write_value(std::string &out, T value) {
+		out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+	}
+
+	template<typename T>
+	bool read_value(const char *&pos, const char *end, T &value) {
+		if (static_cast<size_t>(end - pos) < sizeof(value)) return false;
+		memcpy(&value, pos, sizeof(value));
+		pos += sizeof(value);
+		return true;
+	}
+
+	/// Header of a cache file, used to check that it matches the script it's
+	/// being loaded for
+	std::string cache_header(uint32_t checksum, uint64_t size) {
+		std::string header(cache_magic);
+		header += LUAJIT_VERSION;
+		header += '\0';
+		write_value(header, checksum);
+		write_value(header, size);
+		return header;
+	}
+
+	int string_writer(lua_State *, const void *p, size_t sz, void *ud) {
+		static_cast<std::string *>(ud)->append(static_cast<const char *>(p), sz);
+		return 0;
+	}
+
+	/// Write the function at func_idx and the moonscript line table at
+	/// line_table_idx (if not zero) to the cache
+	void save_cache(lua_State *L, agi::fs::path const& cache, std::string const& header, int func_idx, int line_table_idx) {
+		if (cache.empty()) return;
+
+		std::string data = header;
+
+		std::vector<std::pair<int32_t, int32_t>> lines;
+		if (line_table_idx) {
+			lua_pushvalue(L, line_table_idx);
+			lua_for_each(L, [&] {
+				if (lua_isnumber(L, -2) && lua_isnumber(L, -1))
+					lines.emplace_back(lua_tointeger(L, -2), lua_tointeger(L, -1));
+			});
+		}
+		write_value(data, static_cast<uint32_t>(lines.size()));
+		for (auto const& line : lines) {
+			write_value(data, line.first);
+			write_value(data, line.second);
+		}
+
+		lua_pushvalue(L, func_idx);
+		int err = lua_dump(L, string_writer, &data);
+		lua_pop(L, 1);
+		if (err) return;
+
+		try {
+			agi::io::Save file(cache, true);
+			file.Get().write(data.data(), data.size());
+		}
+		catch (agi::Exception const& e) {
+			LOG_D("auto4/lua") << "Error writing bytecode cache: " << e.GetMessage();
+		}
+	}
+
+	/// Try to load a script from the cache, pushing the function and
+	/// storing the moonscript line table if it worked
+	bool load_cache(lua_State *L, agi::fs::path const& cache, std::string const& header, std::string const& chunkname, bool moon) {
+		if (cache.empty() || !agi::fs::FileExists(cache)) return false;
+
+		try {
+			agi::read_file_mapping file(cache);
+			auto pos = file.read();
+			auto end = pos + file.size();
+
+			if (static_cast<size_t>(end - pos) < header.size() || memcmp(pos, header.data(), header.size()) != 0)
+				return false;
+			pos += header.size();
+
+			uint32_t line_count;
+			if (!read_value(pos, end, line_count) || static_cast<size_t>(end - pos) / 8 < line_count)
+				return false;
+
+			if (moon)
+				lua_createtable(L, line_count, 0);
+			for (uint32_t i = 0; i < line_count; ++i) {
+				int32_t lua_line, char_pos;
+				read_value(pos, end, lua_line);
+				read_value(pos, end, char_pos);
+				if (moon) {
+					push_value(L, char_pos);
+					lua_rawseti(L, -2, lua_line);
+				}
+			}
+
+			if (luaL_loadbuffer(L, pos, end - pos, chunkname.c_str())) {
+				lua_pop(L, moon ? 2 : 1);
+				return false;
+			}
+
+			if (moon) {
+				lua_insert(L, -2);
+				lua_setfield(L, LUA_REGISTRYINDEX, ("moonscript line table: " + chunkname).c_str());
+			}
+			return true;
+		}
+		catch (agi::Exception const& e) {
+			LOG_D("auto4/lua") << "Error reading bytecode cache: " << e.GetMessage();
+			return false;
+		}
+	}
+
+	/// Push moonscript's to_lua function, loading moonscript if needed
+	bool push_moonscript_compiler(lua_State *L) {
+		lua_getfield(L, LUA_REGISTRYINDEX, "moonscript");
+		if (!lua_isnil(L, -1))
+			return true;
+		lua_pop(L, 1);
+
+		luaL_loadstring(L, "return require('moonscript').to_lua");
+		if (lua_pcall(L, 0, 1, 0))
+			return false; // leave error message
+		lua_pushvalue(L, -1);
+		lua_setfield(L, LUA_REGISTRYINDEX, "moonscript");
+		return true;
+	}
+}
 
 namespace agi { namespace lua {
 	bool LoadFile(lua_State *L, agi::fs::path const& raw_filename) {
@@ -44,31 +205,62 @@ namespace agi { namespace lua {
 			size -= 3;
 		}
 
-		if (!agi::fs::HasExtension(filename, "moon"))
-			return luaL_loadbuffer(L, buff, size, filename.string().c_str()) == 0;
+		bool moon = agi::fs::HasExtension(filename, "moon");
+		auto chunkname = filename.string();
+
+		// Save the text we'll be loading for the line number rewriting in the
+		// error handling
+		if (moon) {
+			lua_pushlstring(L, buff, size);
+			lua_setfield(L, LUA_REGISTRYINDEX, ("raw moonscript: " + chunkname).c_str());
+		}
+
+		// Compiling scripts (and moonscript in particular) is slow enough to
+		// noticeably delay startup, so reuse the result from the last time the
+		// script was loaded if it hasn't changed
+		boost::crc_32_type hash;
+		hash.process_bytes(buff, size);
+		auto header = cache_header(hash.checksum(), size);
+		auto cache = cache_path(L, filename, size);
+		if (load_cache(L, cache, header, chunkname, moon))
+			return true;
 
-		// We have a MoonScript file, so we need to load it with that
+		if (!moon) {
+			if (luaL_loadbuffer(L, buff, size, chunkname.c_str()))
+				return false;
+			save_cache(L, cache, header, lua_gettop(L), 0);
+			return true;
+		}
+
+		// We have a MoonScript file, so we need to compile it to Lua
 		// It might be nice to have a dedicated lua state for compiling
 		// MoonScript to Lua
-		lua_getfield(L, LUA_REGISTRYINDEX, "moonscript");
+		if (!push_moonscript_compiler(L))
+			return false;
 
-		// Save the text we'll be loading for the line number rewriting in the
-		// error handling
 		lua_pushlstring(L, buff, size);
-		lua_pushvalue(L, -1);
-		lua_setfield(L, LUA_REGISTRYINDEX, ("raw moonscript: " + filename.string()).c_str());
-
-		push_value(L, filename);
-		if (lua_pcall(L, 2, 2, 0))
+		if (lua_pcall(L, 1, 2, 0))
 			return false; // Leaves error message on stack
 
-		// loadstring returns nil, error on error or a function on success
-		if (lua_isnil(L, 1)) {
-			lua_remove(L, 1);
+		// to_lua returns nil, error on error or the code and the line table
+		// on success
+		if (lua_isnil(L, -2)) {
+			lua_remove(L, -2);
+			return false;
+		}
+
+		size_t code_len;
+		auto code = lua_tolstring(L, -2, &code_len);
+		if (luaL_loadbuffer(L, code, code_len, chunkname.c_str())) {
+			lua_replace(L, -3);
+			lua_pop(L, 1);
 			return false;
 		}
 
-		lua_pop(L, 1); // Remove the extra nil for the stackchecker
+		// Replace the code with the function, leaving the line table on top
+		lua_replace(L, -3);
+		save_cache(L, cache, header, lua_gettop(L) - 1, lua_gettop(L));
+		lua_setfield(L, LUA_REGISTRYINDEX, ("moonscript line table: " + chunkname).c_str());
 		return true;
 	}
 
@@ -146,12 +338,22 @@ namespace agi { namespace lua {
 		lua_rawseti(L, -2, 2);
 		lua_pop(L, 2); // loaders, package
 
-		luaL_loadstring(L, "return require('moonscript').loadstring");
-		if (lua_pcall(L, 0, 1, 0)) {
-			return false; // leave error message
-		}
-		lua_setfield(L, LUA_REGISTRYINDEX, "moonscript");
+		// MoonScript is loaded the first time a .moon file has to be compiled
+		// so that states which only load cached scripts don't pay for it
 
 		return true;
 	}
+
+	void EnableBytecodeCache(lua_State *L, fs::path const& cache_dir) {
+		try {
+			agi::fs::CreateDirectory(cache_dir);
+		}
+		catch (agi::Exception const& e) {
+			LOG_E("auto4/lua") << "Error creating bytecode cache directory: " << e.GetMessage();
+			return;
+		}
+
+		push_value(L, cache_dir);
+		lua_setfield(L, LUA_REGISTRYINDEX, "bytecode cache");
+	}
 } }
@@ -89,27 +89,34 @@ void *check_udata(lua_State *L, int idx, const char *mt) {
 }
 
 static int moon_line(lua_State *L, int lua_line, std::string const& file) {
-	if (luaL_dostring(L, "return require 'moonscript.line_tables'")) {
-		lua_pop(L, 1); // pop error message
-		return lua_line;
-	}
-
-	push_value(L, file);
-	lua_rawget(L, -2);
+	int top = lua_gettop(L);
 
+	// Scripts loaded by LoadFile store their line tables in the registry, as
+	// they may have been loaded from the cache without ever loading moonscript
+	lua_getfield(L, LUA_REGISTRYINDEX, ("moonscript line table: " + file).c_str());
 	if (!lua_istable(L, -1)) {
-		lua_pop(L, 2);
-		return lua_line;
+		if (luaL_dostring(L, "return require 'moonscript.line_tables'")) {
+			lua_settop(L, top); // pop error message
+			return lua_line;
+		}
+
+		push_value(L, file);
+		lua_rawget(L, -2);
+
+		if (!lua_istable(L, -1)) {
+			lua_settop(L, top);
+			return lua_line;
+		}
 	}
 
 	lua_rawgeti(L, -1, lua_line);
 	if (!lua_isnumber(L, -1)) {
-		lua_pop(L, 3);
+		lua_settop(L, top);
 		return lua_line;
 	}
 
 	auto char_pos = static_cast<size_t>(lua_tonumber(L, -1));
-	lua_pop(L, 3);
+	lua_settop(L, top);
 
 	// The moonscript line tables give us a character offset into the file,
 	// so now we need to map that to a line number
@@ -35,21 +35,19 @@
 #include "subtitle_format.h"
 #include "utils.h"
 
+#include <libaegisub/ass/dialogue_line.h>
 #include <libaegisub/of_type_adaptor.h>
-#include <libaegisub/split.h>
 #include <libaegisub/make_unique.h>
 
-#include <boost/algorithm/string/predicate.hpp>
+#include <algorithm>
+#include <atomic>
+#include <list>
 #include <boost/algorithm/string/join.hpp>
-#include <boost/algorithm/string/trim.hpp>
-#include <boost/lexical_cast.hpp>
-#include <boost/regex.hpp>
-#include <boost/spirit/include/karma_generate.hpp>
-#include <boost/spirit/include/karma_int.hpp>
 
 using namespace boost::adaptors;
 
-static int next_id = 0;
+// Lines are created in parallel when loading files
+static std::atomic<int> next_id{0};
 
 AssDialogue::AssDialogue() {
 	Id = ++next_id;
@@ -71,128 +69,53 @@ AssDialogue::AssDialogue(std::string const& data) {
 
 AssDialogue::~AssDialogue () { }
 
-class tokenizer {
-	agi::StringRange str;
-	agi::split_iterator<agi::StringRange::const_iterator> pos;
-
-public:
-	tokenizer(agi::StringRange const& str) : str(str) , pos(agi::Split(str, ',')) { }
-
-	agi::StringRange next_tok() {
-		if (pos.eof())
-			throw SubtitleFormatParseError("Failed parsing line: " + std::string(str.begin(), str.end()));
-		return *pos++;
-	}
+static std::string str(agi::ass::CharRange range) {
+	return std::string(range.begin(), range.end());
+}
 
-	std::string next_str() { return agi::str(next_tok()); }
-	std::string next_str_trim() { return agi::str(boost::trim_copy(next_tok())); }
-};
+static agi::ass::CharRange range(std::string const& str) {
+	return agi::ass::CharRange(str.data(), str.data() + str.size());
+}
 
 void AssDialogue::Parse(std::string const& raw) {
-	agi::StringRange str;
-	if (boost::starts_with(raw, "Dialogue:")) {
-		Comment = false;
-		str = agi::StringRange(raw.begin() + 10, raw.end());
-	}
-	else if (boost::starts_with(raw, "Comment:")) {
-		Comment = true;
-		str = agi::StringRange(raw.begin() + 9, raw.end());
-	}
-	else
+	agi::ass::DialogueLine line;
+	if (!agi::ass::ParseDialogue(raw.data(), raw.data() + raw.size(), line))
 		throw SubtitleFormatParseError("Failed parsing line: " + raw);
 
-	tokenizer tkn(str);
-
-	// Get first token and see if it has "Marked=" in it
-	auto tmp = tkn.next_str_trim();
-	bool ssa = boost::istarts_with(tmp, "marked=");
-
-	// Get layer number
-	if (ssa)
-		Layer = 0;
-	else
-		Layer = boost::lexical_cast<int>(tmp);
-
-	Start = tkn.next_str_trim();
-	End = tkn.next_str_trim();
-	Style = tkn.next_str_trim();
-	Actor = tkn.next_str_trim();
-	for (int& margin : Margin)
-		margin = mid(0, boost::lexical_cast<int>(tkn.next_str()), 9999);
-	Effect = tkn.next_str_trim();
-
-	std::string text{tkn.next_tok().begin(), str.end()};
-
-	if (text.size() > 1 && text[0] == '{' && text[1] == '=') {
-		static const boost::regex extradata_test("^\\{(=\\d+)+\\}");
-		boost::match_results<std::string::iterator> rematch;
-		if (boost::regex_search(text.begin(), text.end(), rematch, extradata_test)) {
-			std::string extradata_str = rematch.str(0);
-			text = rematch.suffix().str();
-
-			static const boost::regex idmatcher("=(\\d+)");
-			auto start = extradata_str.begin();
-			auto end = extradata_str.end();
-			std::vector<uint32_t> ids;
-			while (boost::regex_search(start, end, rematch, idmatcher)) {
-				auto id = boost::lexical_cast<uint32_t>(rematch.str(1));
-				ids.push_back(id);
-				start = rematch.suffix().first;
-			}
-			ExtradataIds = ids;
-		}
-	}
-
-	Text = text;
-}
-
-static void append_int(std::string &str, int v) {
-	boost::spirit::karma::generate(back_inserter(str), boost::spirit::karma::int_, v);
-	str += ',';
-}
-
-static void append_str(std::string &out, std::string const& str) {
-	out += str;
-	out += ',';
+	Comment = line.comment;
+	Layer = line.layer;
+	Start = line.start;
+	End = line.end;
+	Style = str(line.style);
+	Actor = str(line.actor);
+	std::copy(std::begin(line.margin), std::end(line.margin), Margin.begin());
+	Effect = str(line.effect);
+	if (!line.extradata_ids.empty())
+		ExtradataIds = line.extradata_ids;
+	Text = str(line.text);
 }
 
-static void append_unsafe_str(std::string &out, std::string const& str) {
-	for (auto c : str) {
-		if (c == ',')
-			out += ';';
-		else
-			out += c;
-	}
-	out += ',';
+void AssDialogue::GetEntryData(std::string &out) const {
+	agi::ass::DialogueLine line;
+	line.comment = Comment;
+	line.layer = Layer;
+	line.start = Start;
+	line.end = End;
+	line.style = range(Style);
+	line.actor = range(Actor);
+	std::copy(Margin.begin(), Margin.end(), std::begin(line.margin));
+	line.effect = range(Effect);
+	if (!ExtradataIds.get().empty())
+		line.extradata_ids = ExtradataIds;
+	line.text = range(Text);
+
+	out.clear();
+	agi::ass::SerializeDialogue(line, out);
 }
 
 std::string AssDialogue::GetEntryData() const {
-	std::string str = Comment ? "Comment: " : "Dialogue: ";
-	str.reserve(51 + Style.get().size() + Actor.get().size() + Effect.get().size() + Text.get().size());
-
-	append_int(str, Layer);
-	append_str(str, Start.GetAssFormatted());
-	append_str(str, End.GetAssFormatted());
-	append_unsafe_str(str, Style);
-	append_unsafe_str(str, Actor);
-	for (auto margin : Margin)
-		append_int(str, margin);
-	append_unsafe_str(str, Effect);
-
-	if (ExtradataIds.get().size() > 0) {
-		str += '{';
-		for (auto id : ExtradataIds.get()) {
-			str += '=';
-			boost::spirit::karma::generate(back_inserter(str), boost::spirit::karma::int_, id);
-		}
-		str += '}';
-	}
-
-	for (auto c : Text.get()) {
-		if (c != '\n' && c != '\r')
-			str += c;
-	}
-
+	std::string str;
+	GetEntryData(str);
 	return str;
 }
 
@@ -266,6 +189,34 @@ plain:
 	return Blocks;
 }
 
+namespace {
+struct parsed_tags {
+	/// Holding a reference to the text keeps its address from being reused
+	/// for a different string while the entry is in the cache
+	boost::flyweight<std::string> text;
+	std::shared_ptr<const std::vector<std::unique_ptr<AssDialogueBlock>>> blocks;
+};
+}
+
+std::shared_ptr<const std::vector<std::unique_ptr<AssDialogueBlock>>> AssDialogue::GetParsedTags() const {
+	// Override parameters are parsed lazily, so blocks can't be safely
+	// shared between threads and each thread gets its own cache
+	static thread_local std::list<parsed_tags> cache;
+	static const size_t max_cached = 64;
+
+	// Flyweights compare by the address of the shared value
+	auto it = find_if(begin(cache), end(cache), [&](parsed_tags const& p) { return p.text == Text; });
+	if (it != end(cache)) {
+		cache.splice(begin(cache), cache, it);
+		return it->blocks;
+	}
+
+	cache.push_front(parsed_tags{Text, std::make_shared<std::vector<std::unique_ptr<AssDialogueBlock>>>(ParseTags())});
+	if (cache.size() > max_cached)
+		cache.pop_back();
+	return cache.front().blocks;
+}
+
 void AssDialogue::StripTags() {
 	Text = GetStrippedText();
 }
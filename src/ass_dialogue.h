@@ -34,6 +34,7 @@
 
 #include <array>
 #include <boost/flyweight.hpp>
+#include <memory>
 #include <vector>
 
 enum class AssBlockType {
@@ -155,6 +156,12 @@ public:
 
 	/// Parse text as ASS and return block information
 	std::vector<std::unique_ptr<AssDialogueBlock>> ParseTags() const;
+	/// @brief Get the parsed blocks of the text without reparsing it
+	///
+	/// The blocks are shared with every line with the same text and are
+	/// reused until the text changes, so they must not be modified. Use
+	/// ParseTags() to get blocks to edit and pass to UpdateText().
+	std::shared_ptr<const std::vector<std::unique_ptr<AssDialogueBlock>>> GetParsedTags() const;
 
 	/// Strip all ASS tags from the text
 	void StripTags();
@@ -165,6 +172,8 @@ public:
 	/// Update the text of the line from parsed blocks
 	void UpdateText(std::vector<std::unique_ptr<AssDialogueBlock>>& blocks);
 	std::string GetEntryData() const;
+	/// Serialize the line into out, reusing its storage
+	void GetEntryData(std::string &out) const;
 
 	/// Does this line collide with the passed line?
 	bool CollidesWith(const AssDialogue *target) const;
@@ -21,7 +21,11 @@
 #include "ass_info.h"
 #include "ass_style.h"
 #include "ass_style_storage.h"
+#include "ass_time_index.h"
 #include "options.h"
+#include "selection_controller.h"
+
+#include <libaegisub/make_unique.h>
 
 #include <algorithm>
 #include <boost/algorithm/string/case_conv.hpp>
@@ -85,6 +89,8 @@ void AssFile::swap(AssFile& from) throw() {
 	Extradata.swap(from.Extradata);
 	std::swap(Properties, from.Properties);
 	std::swap(next_extradata_id, from.next_extradata_id);
+	time_index.reset();
+	from.time_index.reset();
 }
 
 AssFile& AssFile::operator=(AssFile from) {
@@ -173,6 +179,16 @@ int AssFile::Commit(wxString const& desc, int type, int amend_id, AssDialogue *s
 		int i = 0;
 		for (auto& event : Events)
 			event.Row = i++;
+		AnnounceRenumber();
+	}
+
+	if (type == COMMIT_NEW || (type & COMMIT_DIAG_ADDREM))
+		time_index.reset();
+	else if (type & COMMIT_DIAG_TIME) {
+		if (single_line)
+			LineTimesChanged(single_line);
+		else
+			time_index.reset();
 	}
 
 	PushState({desc, &amend_id, single_line});
@@ -182,6 +198,17 @@ int AssFile::Commit(wxString const& desc, int type, int amend_id, AssDialogue *s
 	return amend_id;
 }
 
+std::vector<AssDialogue *> AssFile::LinesInRange(int start, int end) {
+	if (!time_index)
+		time_index = agi::make_unique<AssTimeIndex>(*this);
+	return time_index->Overlapping(start, end);
+}
+
+void AssFile::LineTimesChanged(AssDialogue *line, AssDialogue const *replaced) {
+	if (time_index && !time_index->Update(line, replaced))
+		time_index.reset();
+}
+
 bool AssFile::CompStart(AssDialogue const& lft, AssDialogue const& rgt) {
 	return lft.Start < rgt.Start;
 }
@@ -201,11 +228,19 @@ bool AssFile::CompLayer(AssDialogue const& lft, AssDialogue const& rgt) {
 	return lft.Layer < rgt.Layer;
 }
 
-void AssFile::Sort(CompFunc comp, std::set<AssDialogue*> const& limit) {
+void AssFile::Sort(CompFunc comp) {
+	Sort(Events, comp);
+}
+
+void AssFile::Sort(CompFunc comp, Selection const& limit) {
 	Sort(Events, comp, limit);
 }
 
-void AssFile::Sort(EntryList<AssDialogue> &lst, CompFunc comp, std::set<AssDialogue*> const& limit) {
+void AssFile::Sort(EntryList<AssDialogue> &lst, CompFunc comp) {
+	lst.sort(comp);
+}
+
+void AssFile::Sort(EntryList<AssDialogue> &lst, CompFunc comp, Selection const& limit) {
 	if (limit.empty()) {
 		lst.sort(comp);
 		return;
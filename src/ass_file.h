@@ -34,6 +34,7 @@
 
 #include <boost/intrusive/list.hpp>
 #include <map>
+#include <memory>
 #include <set>
 #include <vector>
 
@@ -41,6 +42,8 @@ class AssAttachment;
 class AssDialogue;
 class AssInfo;
 class AssStyle;
+class AssTimeIndex;
+class Selection;
 class wxString;
 
 template<typename T>
@@ -82,6 +85,13 @@ class AssFile {
 	/// A set of changes has been committed to the file (AssFile::COMMITType)
 	agi::signal::Signal<int, const AssDialogue*> AnnounceCommit;
 	agi::signal::Signal<AssFileCommit> PushState;
+	/// Dialogue lines have been renumbered by a commit. This is sent before
+	/// anything else about the commit so that things indexed by row number
+	/// are up to date by the time any commit listener runs.
+	agi::signal::Signal<> AnnounceRenumber;
+
+	/// Index of Events by time, built the first time it's needed
+	std::unique_ptr<AssTimeIndex> time_index;
 public:
 	/// The lines in the file
 	std::vector<AssInfo> Info;
@@ -126,6 +136,19 @@ public:
 	/// Set the value of a [Script Info] key. Adds it if it doesn't exist.
 	void SetScriptInfo(std::string const& key, std::string const& value);
 
+	/// @brief Get the dialogue lines whose times overlap [start, end)
+	/// @return Lines ordered by start time, including commented lines
+	///
+	/// The index used is kept up to date by Commit(), so this should not be
+	/// used while there are uncommitted changes to the times of lines.
+	std::vector<AssDialogue *> LinesInRange(int start, int end);
+	/// Get the dialogue lines which are visible at the given time, including commented lines
+	std::vector<AssDialogue *> LinesAtTime(int time) { return LinesInRange(time, time + 1); }
+	/// @brief Update the time index for a line changed without committing
+	/// @param line     Line whose times changed
+	/// @param replaced Line which line replaced in Events, if any
+	void LineTimesChanged(AssDialogue *line, AssDialogue const *replaced = nullptr);
+
 	/// @brief Add a new extradata entry
 	/// @param key Class identifier/owner for the extradata
 	/// @param value Data for the extradata
@@ -170,6 +193,7 @@ public:
 
 	DEFINE_SIGNAL_ADDERS(AnnounceCommit, AddCommitListener)
 	DEFINE_SIGNAL_ADDERS(PushState, AddUndoManager)
+	DEFINE_SIGNAL_ADDERS(AnnounceRenumber, AddRenumberListener)
 
 	/// @brief Flag the file as modified and push a copy onto the undo stack
 	/// @param desc        Undo description
@@ -197,10 +221,16 @@ public:
 
 	/// @brief Sort the dialogue lines in this file
 	/// @param comp Comparison function to use. Defaults to sorting by start time.
+	void Sort(CompFunc comp = CompStart);
+	/// @brief Sort some of the dialogue lines in this file
+	/// @param comp Comparison function to use
 	/// @param limit If non-empty, only lines in this set are sorted
-	void Sort(CompFunc comp = CompStart, std::set<AssDialogue*> const& limit = std::set<AssDialogue*>());
+	void Sort(CompFunc comp, Selection const& limit);
 	/// @brief Sort the dialogue lines in the given list
 	/// @param comp Comparison function to use. Defaults to sorting by start time.
+	static void Sort(EntryList<AssDialogue>& lst, CompFunc comp = CompStart);
+	/// @brief Sort some of the dialogue lines in the given list
+	/// @param comp Comparison function to use
 	/// @param limit If non-empty, only lines in this set are sorted
-	static void Sort(EntryList<AssDialogue>& lst, CompFunc comp = CompStart, std::set<AssDialogue*> const& limit = std::set<AssDialogue*>());
+	static void Sort(EntryList<AssDialogue>& lst, CompFunc comp, Selection const& limit);
 };
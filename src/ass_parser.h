@@ -40,4 +40,8 @@ public:
 	~AssParser();
 
 	void AddLine(std::string const& data);
+
+	/// Would a Dialogue or Comment line passed to AddLine next be added to
+	/// the file's events?
+	bool InEventsSection() const { return !attach && state == &AssParser::ParseEventLine; }
 };
@@ -0,0 +1,79 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "ass_time_index.h"
+
+#include "ass_dialogue.h"
+#include "ass_file.h"
+
+#include <algorithm>
+#include <limits>
+
+AssTimeIndex::AssTimeIndex(AssFile &file) {
+	for (auto& line : file.Events)
+		entries.push_back(entry{line.Start, line.End, &line});
+	std::stable_sort(begin(entries), end(entries), [](entry const& a, entry const& b) {
+		return a.start < b.start;
+	});
+	max_end.resize(entries.size());
+	BuildMaxEnd(0, entries.size());
+}
+
+int AssTimeIndex::BuildMaxEnd(size_t begin, size_t end) {
+	if (begin == end) return std::numeric_limits<int>::min();
+	size_t mid = begin + (end - begin) / 2;
+	int left = BuildMaxEnd(begin, mid);
+	int right = BuildMaxEnd(mid + 1, end);
+	return max_end[mid] = std::max(entries[mid].end, std::max(left, right));
+}
+
+bool AssTimeIndex::Update(AssDialogue *line, AssDialogue const *replaced) {
+	if (!replaced) replaced = line;
+	auto it = find_if(begin(entries), end(entries), [&](entry const& e) { return e.line == replaced; });
+	if (it == end(entries)) return false;
+	entries.erase(it);
+
+	entry updated{line->Start, line->End, line};
+	auto pos = std::upper_bound(begin(entries), end(entries), updated, [](entry const& a, entry const& b) {
+		return a.start < b.start;
+	});
+	entries.insert(pos, updated);
+	BuildMaxEnd(0, entries.size());
+	return true;
+}
+
+void AssTimeIndex::Query(size_t begin, size_t end, int start_time, int end_time, std::vector<AssDialogue *> &out) const {
+	while (begin != end) {
+		size_t mid = begin + (end - begin) / 2;
+		// Nothing under this node is still going at the start of the range
+		if (max_end[mid] <= start_time) return;
+
+		Query(begin, mid, start_time, end_time, out);
+
+		// This line and everything after it start after the range
+		if (entries[mid].start >= end_time) return;
+		if (entries[mid].end > start_time)
+			out.push_back(entries[mid].line);
+
+		begin = mid + 1;
+	}
+}
+
+std::vector<AssDialogue *> AssTimeIndex::Overlapping(int start, int end) const {
+	std::vector<AssDialogue *> ret;
+	Query(0, entries.size(), start, end, ret);
+	return ret;
+}
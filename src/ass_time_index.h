@@ -0,0 +1,55 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <vector>
+
+class AssDialogue;
+class AssFile;
+
+/// @class AssTimeIndex
+/// @brief Index of dialogue lines by time
+///
+/// Lines are kept sorted by start time along with an implicit binary tree of
+/// the latest end time under each node, which lets overlap queries skip
+/// entire runs of lines which have already ended.
+class AssTimeIndex {
+	struct entry {
+		int start;
+		int end;
+		AssDialogue *line;
+	};
+
+	std::vector<entry> entries;
+	/// Latest end time of the entries in the subtree rooted at each index
+	std::vector<int> max_end;
+
+	int BuildMaxEnd(size_t begin, size_t end);
+	void Query(size_t begin, size_t end, int start_time, int end_time, std::vector<AssDialogue *> &out) const;
+
+public:
+	AssTimeIndex(AssFile &file);
+
+	/// @brief Move a line to the right place after its times changed
+	/// @param line     Line whose times changed
+	/// @param replaced Line which line has replaced, if it's a different object
+	/// @return false if the old line isn't in the index
+	bool Update(AssDialogue *line, AssDialogue const *replaced);
+
+	/// Get the lines overlapping [start, end), ordered by start time
+	std::vector<AssDialogue *> Overlapping(int start, int end) const;
+};
@@ -20,10 +20,15 @@
 #include "ass_file.h"
 #include "export_fixstyle.h"
 #include "include/aegisub/subtitles_provider.h"
+#include "options.h"
 #include "video_frame.h"
 #include "video_provider_manager.h"
 
 #include <libaegisub/dispatch.h>
+#include <libaegisub/make_unique.h>
+
+#include <algorithm>
+#include <cmath>
 
 enum {
 	NEW_SUBS_FILE = -1,
@@ -49,6 +54,8 @@ std::shared_ptr<VideoFrame> AsyncVideoProvider::ProcFrame(int frame_number, doub
 		source_provider->GetFrame(frame_number, *frame);
 	}
 	catch (VideoProviderError const& err) { throw VideoProviderErrorEvent(err); }
+	if (prefetch_frames)
+		prefetched.insert(frame_number);
 
 	if (raw || !subs_provider || !subs) return frame;
 
@@ -97,6 +104,18 @@ AsyncVideoProvider::AsyncVideoProvider(agi::fs::path const& video_filename, std:
 , source_provider(VideoProviderFactory::GetProvider(video_filename, colormatrix, br))
 , parent(parent)
 {
+	// Decoding ahead only helps if the decoded frames are kept somewhere,
+	// and is limited to half of the cache so that it can't evict the frames
+	// the user is actually looking at
+	if (source_provider->WantsCaching()) {
+		size_t cache_size = (size_t)OPT_GET("Provider/Video/Cache/Size")->GetInt() << 20;
+		size_t frame_size = std::max<size_t>((size_t)GetWidth() * GetHeight() * 4, 1);
+		prefetch_frames = (int)std::min<size_t>(OPT_GET("Provider/Video/Cache/Prefetch")->GetInt(), cache_size / frame_size / 2);
+	}
+	if (prefetch_frames) {
+		keyframes = source_provider->GetKeyFrames();
+		prefetch_buffer = agi::make_unique<VideoFrame>();
+	}
 }
 
 AsyncVideoProvider::~AsyncVideoProvider() {
@@ -127,9 +146,13 @@ void AsyncVideoProvider::UpdateSubtitles(const AssFile *new_subs, const AssDialo
 		std::advance(it, copy->Row - i);
 		i = copy->Row;
 		subs->Events.insert(it, *copy);
+		subs->LineTimesChanged(copy, &*it);
 		delete &*it--;
 
-		single_frame = NEW_SUBS_FILE;
+		// Providers which can replace a single line don't need the file
+		// to be reloaded
+		if (!subs_provider || !subs_provider->UpdateLine(*copy))
+			single_frame = NEW_SUBS_FILE;
 		ProcAsync(req_version, true);
 	});
 }
@@ -141,12 +164,60 @@ void AsyncVideoProvider::RequestFrame(int new_frame, double new_time) throw() {
 		time = new_time;
 		frame_number = new_frame;
 		ProcAsync(req_version, false);
+		SchedulePrefetch(req_version, new_frame);
 	});
 }
 
+void AsyncVideoProvider::SchedulePrefetch(uint_fast32_t req_version, int frame) {
+	if (!prefetch_frames || req_version < version) return;
+
+	int delta = frame - last_prefetch;
+	last_prefetch = frame;
+
+	// Forget about frames far enough away that they've probably been evicted
+	prefetched.erase(prefetched.begin(), prefetched.lower_bound(frame - 2 * prefetch_frames));
+	prefetched.erase(prefetched.upper_bound(frame + 2 * prefetch_frames), prefetched.end());
+
+	int first, last;
+	if (delta < 0 && delta >= -prefetch_frames) {
+		// Stepping backwards. Decoders seek to the previous keyframe and then
+		// decode forwards, so decoding the frames before this one in order
+		// costs one seek rather than one per frame.
+		auto kf = std::upper_bound(keyframes.begin(), keyframes.end(), frame);
+		int keyframe = kf == keyframes.begin() ? 0 : *(kf - 1);
+		first = std::max(keyframe, frame - prefetch_frames);
+		last = frame;
+	}
+	else {
+		// Playing, stepping forwards or seeking; in all cases the next frames
+		// are the cheapest to decode and the most likely to be wanted
+		first = frame + 1;
+		last = std::min(frame + 1 + prefetch_frames, GetFrameCount());
+	}
+
+	for (int i = first; i < last; ++i) {
+		if (!prefetched.count(i))
+			worker->Async([=] { Prefetch(req_version, i); });
+	}
+}
+
+void AsyncVideoProvider::Prefetch(uint_fast32_t req_version, int frame) {
+	// Any newer request cancels all outstanding prefetching, as it'll
+	// schedule its own if it's still relevant
+	if (req_version < version || prefetched.count(frame)) return;
+
+	try {
+		source_provider->GetFrame(frame, *prefetch_buffer);
+		prefetched.insert(frame);
+	}
+	catch (VideoProviderError const&) {
+		// Errors are reported if and when the frame is actually requested
+	}
+}
+
 bool AsyncVideoProvider::NeedUpdate(std::vector<AssDialogueBase const*> const& visible_lines) {
 	// Always need to render after a seek
-	if (single_frame != NEW_SUBS_FILE || frame_number != last_rendered)
+	if (frame_number != last_rendered)
 		return true;
 
 	// Obviously need to render if the number of visible lines has changed
@@ -178,9 +249,9 @@ void AsyncVideoProvider::ProcAsync(uint_fast32_t req_version, bool check_updated
 	if (req_version < version || frame_number < 0) return;
 
 	std::vector<AssDialogueBase const*> visible_lines;
-	for (auto const& line : subs->Events) {
-		if (!line.Comment && !(line.Start > time || line.End <= time))
-			visible_lines.push_back(&line);
+	for (auto line : subs->LinesAtTime(std::floor(time))) {
+		if (!line->Comment)
+			visible_lines.push_back(line);
 	}
 
 	if (check_updated && !NeedUpdate(visible_lines)) return;
@@ -209,7 +280,10 @@ std::shared_ptr<VideoFrame> AsyncVideoProvider::GetFrame(int frame, double time,
 }
 
 void AsyncVideoProvider::SetColorSpace(std::string const& matrix) {
-	worker->Async([=] { source_provider->SetColorSpace(matrix); });
+	worker->Async([=] {
+		source_provider->SetColorSpace(matrix);
+		prefetched.clear();
+	});
 }
 
 wxDEFINE_EVENT(EVT_FRAME_READY, FrameReadyEvent);
@@ -78,6 +78,25 @@ class AsyncVideoProvider {
 
 	std::vector<std::shared_ptr<VideoFrame>> buffers;
 
+	/// Maximum number of frames to decode ahead of the last requested frame,
+	/// or zero if the source provider is not cached
+	int prefetch_frames = 0;
+	/// Keyframes of the video, used to pick frames to decode when stepping
+	/// backwards
+	std::vector<int> keyframes;
+	/// Previous frame which prefetching was scheduled for
+	int last_prefetch = -1;
+	/// Frames near the cursor which are expected to be in the cache
+	std::set<int> prefetched;
+	/// Scratch frame for decoded frames which no one asked for yet
+	std::unique_ptr<VideoFrame> prefetch_buffer;
+
+	/// Queue decoding of the frames which are likely to be requested after frame
+	void SchedulePrefetch(uint_fast32_t req_version, int frame);
+	/// Decode a frame into the source provider's cache if req_version is
+	/// still the current version
+	void Prefetch(uint_fast32_t req_version, int frame);
+
 public:
 	/// @brief Load the passed subtitle file
 	/// @param subs File to load
@@ -31,6 +31,7 @@
 #include "audio_display.h"
 
 #include "audio_controller.h"
+#include "audio_provider_factory.h"
 #include "audio_renderer.h"
 #include "audio_renderer_spectrum.h"
 #include "audio_renderer_waveform.h"
@@ -47,6 +48,7 @@
 #include <libaegisub/ass/time.h>
 #include <libaegisub/audio/provider.h>
 #include <libaegisub/make_unique.h>
+#include <libaegisub/path.h>
 
 #include <algorithm>
 
@@ -631,6 +633,8 @@ void AudioDisplay::ScrollPixelToLeft(int pixel_position)
 		pixel_position = 0;
 
 	scroll_left = pixel_position;
+	if (audio_renderer_provider)
+		audio_renderer_provider->SetVisibleRange(scroll_left, scroll_left + client_width);
 	scrollbar->SetPosition(scroll_left);
 	timeline->SetPosition(scroll_left);
 	Refresh();
@@ -775,6 +779,8 @@ void AudioDisplay::ReloadRenderingSettings()
 		audio_renderer_provider = agi::make_unique<AudioWaveformRenderer>(colour_scheme_name);
 	}
 
+	audio_renderer_provider->SetSummaryFile(GetSummaryFile());
+	audio_renderer_connection = audio_renderer_provider->AddUpdatedListener(&AudioDisplay::OnRendererUpdated, this);
 	audio_renderer->SetRenderer(audio_renderer_provider.get());
 	scrollbar->SetColourScheme(colour_scheme_name);
 	timeline->SetColourScheme(colour_scheme_name);
@@ -816,6 +822,12 @@ void AudioDisplay::OnLoadTimer(wxTimerEvent&)
 	}
 }
 
+void AudioDisplay::OnRendererUpdated()
+{
+	audio_renderer->Invalidate();
+	RefreshRect(wxRect(0, audio_top, GetClientSize().GetWidth(), audio_height), false);
+}
+
 void AudioDisplay::OnPaint(wxPaintEvent&)
 {
 	if (!audio_renderer_provider || !provider) return;
@@ -1201,6 +1213,9 @@ void AudioDisplay::OnSize(wxSizeEvent &)
 
 	audio_top = timeline->GetHeight();
 
+	if (audio_renderer_provider)
+		audio_renderer_provider->SetVisibleRange(scroll_left, scroll_left + size.x);
+
 	Refresh();
 }
 
@@ -1216,6 +1231,12 @@ int AudioDisplay::GetDuration() const
 	return (provider->GetNumSamples() * 1000 + provider->GetSampleRate() - 1) / provider->GetSampleRate();
 }
 
+agi::fs::path AudioDisplay::GetSummaryFile() const
+{
+	if (!provider) return agi::fs::path();
+	return GetAudioSummaryCacheFilename(context->project->AudioName(), *context->path, "");
+}
+
 void AudioDisplay::OnAudioOpen(agi::AudioProvider *provider)
 {
 	this->provider = provider;
@@ -1223,6 +1244,7 @@ void AudioDisplay::OnAudioOpen(agi::AudioProvider *provider)
 	if (!audio_renderer_provider)
 		ReloadRenderingSettings();
 
+	audio_renderer_provider->SetSummaryFile(GetSummaryFile());
 	audio_renderer->SetAudioProvider(provider);
 	audio_renderer->SetCacheMaxSize(OPT_GET("Audio/Renderer/Spectrum/Memory Max")->GetInt() * 1024 * 1024);
 
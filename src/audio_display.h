@@ -28,6 +28,7 @@
 //
 // Aegisub Project http://www.aegisub.org/
 //
+#include <libaegisub/fs_fwd.h>
 #include <libaegisub/signal.h>
 
 #include <chrono>
@@ -68,6 +69,9 @@ class AudioDisplay: public wxWindow {
 	/// The current audio renderer
 	std::unique_ptr<AudioRendererBitmapProvider> audio_renderer_provider;
 
+	/// Connection to the current audio renderer's updated signal
+	agi::signal::Connection audio_renderer_connection;
+
 	/// The controller managing us
 	AudioController *controller = nullptr;
 
@@ -194,11 +198,15 @@ class AudioDisplay: public wxWindow {
 	void OnKeyDown(wxKeyEvent& event);
 	void OnScrollTimer(wxTimerEvent &event);
 	void OnLoadTimer(wxTimerEvent &);
+	void OnRendererUpdated();
 	void OnMouseEnter(wxMouseEvent&);
 	void OnMouseLeave(wxMouseEvent&);
 
 	int GetDuration() const;
 
+	/// Get the base path for keeping rendering data for the current audio between sessions
+	agi::fs::path GetSummaryFile() const;
+
 	void OnAudioOpen(agi::AudioProvider *provider);
 	void OnPlaybackPosition(int ms_position);
 	void OnSelectionChanged();
@@ -25,6 +25,7 @@
 #include <libaegisub/log.h>
 #include <libaegisub/path.h>
 
+#include <boost/crc.hpp>
 #include <boost/range/iterator_range.hpp>
 
 using namespace agi;
@@ -112,6 +113,12 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(fs::path const& filename,
 	if (!cache || !needs_cache)
 		return CreateLockAudioProvider(std::move(provider));
 
+	auto peak_cache = GetAudioSummaryCacheFilename(filename, path_helper, ".peaks");
+	if (!peak_cache.empty())
+		CleanCache(peak_cache.parent_path(), "*.*",
+			OPT_GET("Audio/Cache/Summary/Size")->GetInt(),
+			OPT_GET("Audio/Cache/Summary/Files")->GetInt());
+
 	// Convert to RAM
 	if (cache == 1) {
 		if (sizeof(void*) == 4 && (provider->GetNumSamples() * provider->GetChannels() * provider->GetBytesPerSample() >= (1 << 30))) {
@@ -125,7 +132,7 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(fs::path const& filename,
 			cache = 2;
 		}
 		else
-			return CreateRAMAudioProvider(std::move(provider));
+			return CreateRAMAudioProvider(std::move(provider), peak_cache);
 	}
 
 	// Convert to HD
@@ -134,8 +141,31 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(fs::path const& filename,
 		if (path == "default")
 			path = "?temp";
 		auto cache_dir = path_helper.MakeAbsolute(path_helper.Decode(path), "?temp");
-		return CreateHDAudioProvider(std::move(provider), cache_dir);
+		return CreateHDAudioProvider(std::move(provider), cache_dir, peak_cache);
 	}
 
 	throw InternalError("Invalid audio caching method");
 }
+
+agi::fs::path GetAudioSummaryCacheFilename(fs::path const& filename, Path const& path_helper, std::string const& extension) {
+	if (!OPT_GET("Audio/Cache/Summary/Enabled")->GetBool())
+		return fs::path();
+
+	try {
+		// Key the cache on the file's path, size and modification time, in
+		// the same way as the FFMS2 index cache
+		uintmax_t len = agi::fs::Size(filename);
+
+		boost::crc_32_type hash;
+		hash.process_bytes(filename.string().c_str(), filename.string().size());
+
+		auto result = path_helper.Decode("?local/audiocache/" + std::to_string(hash.checksum()) + "_" + std::to_string(len) + "_" + std::to_string(agi::fs::ModifiedTime(filename)) + extension);
+		agi::fs::CreateDirectory(result.parent_path());
+		return result;
+	}
+	catch (fs::FileSystemError const& e) {
+		// Not a real file (e.g. dummy audio), so there's nothing to key on
+		LOG_D("audio_provider") << "Not caching audio summaries: " << e.GetMessage();
+		return fs::path();
+	}
+}
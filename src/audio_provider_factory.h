@@ -17,6 +17,7 @@
 #include <libaegisub/fs_fwd.h>
 
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace agi {
@@ -29,3 +30,12 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(agi::fs::path const& filena
                                                      agi::Path const& path_helper,
                                                      agi::BackgroundRunner *br);
 std::vector<std::string> GetAudioProviderNames();
+
+/// Get the path to save display summaries of an audio file to between sessions
+/// @param filename Audio file the summary is of
+/// @param path_helper Path helper used to decode ?local
+/// @param extension Extension identifying the type of summary
+/// @return Cache filename, or an empty path if summaries should not be saved
+agi::fs::path GetAudioSummaryCacheFilename(agi::fs::path const& filename,
+                                           agi::Path const& path_helper,
+                                           std::string const& extension);
@@ -29,6 +29,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -37,6 +38,10 @@
 #include "audio_rendering_style.h"
 #include "block_cache.h"
 
+#include <libaegisub/signal.h>
+
+#include <libaegisub/fs_fwd.h>
+
 class AudioRenderer;
 class AudioRendererBitmapProvider;
 class wxDC;
@@ -230,6 +235,11 @@ protected:
 	/// Vertical zoom/amplitude scale factor
 	float amplitude_scale;
 
+	/// Announce that data which was previously drawn as a placeholder is now
+	/// available, so anything already rendered should be redrawn. Only
+	/// emitted on the GUI thread.
+	agi::signal::Signal<> AnnounceUpdated;
+
 	/// @brief Called when the audio provider changes
 	///
 	/// Implementations can override this method to do something when the audio provider is changed
@@ -282,10 +292,34 @@ public:
 	/// @param amplitude_scale Scaling factor to zoom to
 	void SetAmplitudeScale(float amplitude_scale);
 
+	/// @brief Set the file to keep rendering data in between sessions
+	/// @param file Base path to derive filenames from, or empty to not keep data
+	///
+	/// Must be called before the audio provider is changed, so that data for
+	/// the old audio can be saved. Deriving classes which can reuse their
+	/// data should override this method.
+	virtual void SetSummaryFile(agi::fs::path const& file) { }
+
+	/// @brief Get the number of samples from the start of the audio which can be rendered
+	///
+	/// By default only audio which has been decoded can be rendered, but
+	/// renderers which can draw from saved data may allow more.
+	virtual int64_t GetRenderableSamples() const;
+
+	/// @brief Tell the renderer which part of the audio is on screen
+	/// @param start First visible pixel from the beginning of the audio stream
+	/// @param end   One past the last visible pixel
+	///
+	/// Renderers which derive data in the background can use this to drop
+	/// work for audio which has been scrolled away from.
+	virtual void SetVisibleRange(int start, int end) { }
+
 	/// @brief Age any caches the renderer might keep
 	/// @param max_size Maximum size in bytes the caches should be
 	///
 	/// Deriving classes should override this method if they implement any
 	/// kind of caching.
 	virtual void AgeCache(size_t max_size) { }
+
+	DEFINE_SIGNAL_ADDERS(AnnounceUpdated, AddUpdatedListener)
 };
@@ -35,14 +35,23 @@
 #include "audio_renderer_spectrum.h"
 
 #include "audio_colorscheme.h"
-#ifndef WITH_FFTW3
+#ifdef WITH_FFTW3
+#include <fftw3.h>
+#else
 #include "fft.h"
 #endif
 
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/io.h>
+#include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
 
 #include <wx/image.h>
 #include <wx/dcmemory.h>
@@ -74,6 +83,134 @@ struct AudioSpectrumCacheBlockFactory {
 	}
 };
 
+/// A batch of blocks to derive on the background queue
+struct AudioSpectrumJob {
+	/// Renderer generation the blocks were requested in
+	uint64_t generation;
+	/// Set on the GUI thread once the blocks have been scrolled away from,
+	/// so that they aren't derived if the job hasn't been started yet
+	std::atomic<bool> cancelled{false};
+	/// Whether power holds the derived data, set on the background thread
+	bool computed = false;
+	/// Binary logarithm of the number of samples used for each block
+	size_t derivation_size;
+	/// Indices of the blocks to derive
+	std::vector<size_t> blocks;
+	/// Whether each block was read before all of its audio was decoded
+	std::vector<bool> incomplete;
+	/// Audio for each block, 2 << derivation_size samples per block
+	std::vector<int16_t> audio;
+	/// Derived data for each block, 1 << derivation_size values per block
+	std::vector<float> power;
+};
+
+namespace {
+const char spectrum_file_magic[] = "AGISPEC1";
+
+/// Fixed-point scale used for saved spectrum data. Values are normally in
+/// [0;1], but can occasionally be somewhat greater.
+const float spectrum_quant_scale = 16384.f;
+
+/// Number of blocks derived by each background task
+const size_t blocks_per_job = 16;
+
+#ifdef WITH_FFTW3
+/// Get a plan for deriving blocks of the given size
+///
+/// Plans are only created on the GUI thread and are never destroyed, so
+/// they can be executed from any number of background threads at once.
+fftw_plan GetPlan(size_t derivation_size)
+{
+	static std::map<size_t, fftw_plan> plans;
+	auto& plan = plans[derivation_size];
+	if (!plan)
+	{
+		double *input = fftw_alloc_real(2<<derivation_size);
+		fftw_complex *output = fftw_alloc_complex(2<<derivation_size);
+		// Unaligned so that the plan can be used with each thread's buffers
+		plan = fftw_plan_dft_r2c_1d(2<<derivation_size, input, output, FFTW_MEASURE | FFTW_UNALIGNED);
+		fftw_free(input);
+		fftw_free(output);
+	}
+	return plan;
+}
+#endif
+
+/// @brief Derive frequency-power data for every block in a job
+/// @param job  Job to fill the power data of
+/// @param plan FFTW plan for the job's derivation size
+///
+/// Runs on a background thread, and touches nothing other than the job.
+#ifdef WITH_FFTW3
+void ComputeBlocks(AudioSpectrumJob &job, fftw_plan plan)
+#else
+void ComputeBlocks(AudioSpectrumJob &job)
+#endif
+{
+	const size_t size = job.derivation_size;
+	const size_t input_size = 2 << size;
+	const size_t output_size = 1 << size;
+	job.power.resize(job.blocks.size() << size);
+
+	// Scratch buffers are kept per thread so that they are only allocated
+	// the first time each thread derives a block of a given size
+#ifdef WITH_FFTW3
+	static thread_local std::vector<double> input;
+	static thread_local std::vector<double> output;
+	input.resize(input_size);
+	output.resize((output_size + 1) * 2);
+	auto dft_output = reinterpret_cast<fftw_complex *>(output.data());
+
+	double scale_factor = 9 / sqrt(2 << (size + 1));
+#else
+	// 2x for the input sample data
+	// 2x for the real part of the output
+	// 2x for the imaginary part of the output
+	static thread_local std::vector<float> fft_scratch;
+	fft_scratch.resize(3 * input_size);
+	float *fft_input = &fft_scratch[0];
+	float *fft_real = &fft_scratch[0] + input_size;
+	float *fft_imag = &fft_scratch[0] + 2 * input_size;
+
+	float scale_factor = 9 / sqrt(2 * (float)input_size);
+#endif
+
+	for (size_t i = 0; i < job.blocks.size(); ++i)
+	{
+		const int16_t *audio = &job.audio[i * input_size];
+		float *block = &job.power[i * output_size];
+
+#ifdef WITH_FFTW3
+		for (size_t si = 0; si < input_size; ++si)
+			input[si] = audio[si] / 32768.0;
+
+		fftw_execute_dft_r2c(plan, input.data(), dft_output);
+
+		fftw_complex *o = dft_output;
+		for (size_t si = output_size; si > 0; --si)
+		{
+			*block++ = log10( sqrt(o[0][0] * o[0][0] + o[0][1] * o[0][1]) * scale_factor + 1 );
+			o++;
+		}
+#else
+		for (size_t si = 0; si < input_size; ++si)
+			fft_input[si] = audio[si] / 32768.f;
+
+		FFT fft;
+		fft.Transform(input_size, fft_input, fft_real, fft_imag);
+
+		for (size_t si = 0; si < output_size; ++si)
+		{
+			// With x in range [0;1], log10(x*9+1) will also be in range [0;1],
+			// although the FFT output can apparently get greater magnitudes than 1
+			// despite the input being limited to [-1;+1).
+			*block++ = log10( sqrt(fft_real[si] * fft_real[si] + fft_imag[si] * fft_imag[si]) * scale_factor + 1 );
+		}
+#endif
+	}
+}
+}
+
 /// @brief Cache for audio spectrum frequency-power data
 class AudioSpectrumCache
 : public DataBlockCache<float, 10, AudioSpectrumCacheBlockFactory> {
@@ -85,6 +222,7 @@ public:
 };
 
 AudioSpectrumRenderer::AudioSpectrumRenderer(std::string const& color_scheme_name)
+: self(std::make_shared<AudioSpectrumRenderer *>(this))
 {
 	colors.reserve(AudioStyle_MAX);
 	for (int i = 0; i < AudioStyle_MAX; ++i)
@@ -93,6 +231,11 @@ AudioSpectrumRenderer::AudioSpectrumRenderer(std::string const& color_scheme_nam
 
 AudioSpectrumRenderer::~AudioSpectrumRenderer()
 {
+	SaveSummary();
+
+	// Results of derivations still in progress will be dropped
+	*self = nullptr;
+
 	// This sequence will clean up
 	provider = nullptr;
 	RecreateCache();
@@ -100,40 +243,33 @@ AudioSpectrumRenderer::~AudioSpectrumRenderer()
 
 void AudioSpectrumRenderer::RecreateCache()
 {
-#ifdef WITH_FFTW3
-	if (dft_plan)
-	{
-		fftw_destroy_plan(dft_plan);
-		fftw_free(dft_input);
-		fftw_free(dft_output);
-		dft_plan = nullptr;
-		dft_input = nullptr;
-		dft_output = nullptr;
-	}
-#endif
+	DiscardBlocks();
+	cache.reset();
+	num_samples = 0;
 
 	if (provider)
 	{
-		size_t block_count = (size_t)((provider->GetNumSamples() + ((size_t)1<<derivation_dist) - 1) >> derivation_dist);
+		num_samples = provider->GetNumSamples();
+		size_t block_count = (size_t)((num_samples + ((size_t)1<<derivation_dist) - 1) >> derivation_dist);
 		cache = agi::make_unique<AudioSpectrumCache>(block_count, this);
-
-#ifdef WITH_FFTW3
-		dft_input = fftw_alloc_real(2<<derivation_size);
-		dft_output = fftw_alloc_complex(2<<derivation_size);
-		dft_plan = fftw_plan_dft_r2c_1d(
-			2<<derivation_size,
-			dft_input,
-			dft_output,
-			FFTW_MEASURE);
-#else
-		// Allocate scratch for 6x the derivation size:
-		// 2x for the input sample data
-		// 2x for the real part of the output
-		// 2x for the imaginary part of the output
-		fft_scratch.resize(6 << derivation_size);
-#endif
-		audio_scratch.resize(2 << derivation_size);
 	}
+
+	LoadSummary();
+}
+
+void AudioSpectrumRenderer::DiscardBlocks()
+{
+	if (cache)
+		cache->Age(0);
+	++generation;
+	for (auto& job : jobs)
+		job->cancelled = true;
+	jobs.clear();
+	queued_blocks.clear();
+	pending_blocks.clear();
+	dropped_blocks.clear();
+	computed_blocks.clear();
+	incomplete_blocks.clear();
 }
 
 void AudioSpectrumRenderer::OnSetProvider()
@@ -143,11 +279,16 @@ void AudioSpectrumRenderer::OnSetProvider()
 
 void AudioSpectrumRenderer::SetResolution(size_t _derivation_size, size_t _derivation_dist)
 {
+	if (derivation_dist == _derivation_dist && derivation_size == _derivation_size)
+		return;
+
+	// The cached blocks are about to be discarded, so save them first
+	SaveSummary();
+
 	if (derivation_dist != _derivation_dist)
 	{
 		derivation_dist = _derivation_dist;
-		if (cache)
-			cache->Age(0);
+		DiscardBlocks();
 	}
 
 	if (derivation_size != _derivation_size)
@@ -155,13 +296,128 @@ void AudioSpectrumRenderer::SetResolution(size_t _derivation_size, size_t _deriv
 		derivation_size = _derivation_size;
 		RecreateCache();
 	}
+	else
+		LoadSummary();
+}
+
+void AudioSpectrumRenderer::SetSummaryFile(agi::fs::path const& file)
+{
+	if (file == summary_file)
+		return;
+
+	SaveSummary();
+	summary_file = file;
+
+	// Whatever is in the cache belongs to the old file
+	DiscardBlocks();
+	LoadSummary();
 }
 
-template<class T>
-void AudioSpectrumRenderer::ConvertToFloat(size_t count, T *dest) {
-	for (size_t si = 0; si < count; ++si)
+agi::fs::path AudioSpectrumRenderer::SummaryFilename() const
+{
+	// Saved blocks can only be reused at the same resolution
+	return summary_file.string() + "_" + std::to_string(derivation_size) + "_" + std::to_string(derivation_dist) + ".spectrum";
+}
+
+void AudioSpectrumRenderer::LoadSummary()
+{
+	saved_blocks.clear();
+	incomplete_blocks.clear();
+	if (summary_file.empty() || !provider)
+		return;
+
+	const auto filename = SummaryFilename();
+	if (!agi::fs::FileExists(filename))
+		return;
+
+	try
 	{
-		dest[si] = (T)(audio_scratch[si]) / 32768.0;
+		auto stream = agi::io::Open(filename, true);
+
+		char magic[sizeof(spectrum_file_magic) - 1];
+		int64_t file_samples = 0;
+		uint64_t count = 0;
+		stream->read(magic, sizeof(magic));
+		stream->read(reinterpret_cast<char *>(&file_samples), sizeof(file_samples));
+		stream->read(reinterpret_cast<char *>(&count), sizeof(count));
+		if (!stream->good() || memcmp(magic, spectrum_file_magic, sizeof(magic)) || file_samples != num_samples)
+			return;
+
+		const size_t block_size = (size_t)1 << derivation_size;
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			uint64_t index = 0;
+			std::vector<uint16_t> block(block_size);
+			stream->read(reinterpret_cast<char *>(&index), sizeof(index));
+			stream->read(reinterpret_cast<char *>(block.data()), block_size * sizeof(uint16_t));
+			if (!stream->good())
+				break;
+			saved_blocks[(size_t)index] = std::move(block);
+		}
+	}
+	catch (agi::Exception const& e)
+	{
+		LOG_D("audio/renderer/spectrum") << "Failed to load " << filename << ": " << e.GetMessage();
+	}
+}
+
+void AudioSpectrumRenderer::SaveSummary()
+{
+	// The provider may already have been destroyed when this is called for
+	// the old audio, so only the cache and num_samples can be used here
+	if (summary_file.empty() || !cache)
+		return;
+
+	const size_t block_size = (size_t)1 << derivation_size;
+
+	// Blocks used from the saved data are removed from saved_blocks when
+	// they're put into the cache, so the two never overlap
+	size_t count = saved_blocks.size();
+	cache->ForEach([&](size_t index, float const&) {
+		if (!incomplete_blocks.count(index)) ++count;
+	});
+
+	// Don't let the saved data grow past what the cache is allowed to hold
+	if (cache_max_size)
+		count = std::min(count, cache_max_size / (block_size * sizeof(float)));
+	if (!count)
+		return;
+
+	try
+	{
+		agi::io::Save file(SummaryFilename(), true);
+		auto& out = file.Get();
+
+		const uint64_t count64 = count;
+		out.write(spectrum_file_magic, sizeof(spectrum_file_magic) - 1);
+		out.write(reinterpret_cast<const char *>(&num_samples), sizeof(num_samples));
+		out.write(reinterpret_cast<const char *>(&count64), sizeof(count64));
+
+		std::vector<uint16_t> quantised(block_size);
+		auto write_block = [&](size_t index, uint16_t const* data)
+		{
+			if (!count) return;
+			--count;
+			const uint64_t index64 = index;
+			out.write(reinterpret_cast<const char *>(&index64), sizeof(index64));
+			out.write(reinterpret_cast<const char *>(data), block_size * sizeof(uint16_t));
+		};
+
+		cache->ForEach([&](size_t index, float const& block)
+		{
+			if (incomplete_blocks.count(index)) return;
+			const float *power = &block;
+			for (size_t i = 0; i < block_size; ++i)
+				quantised[i] = (uint16_t)std::min(65535.f, power[i] * spectrum_quant_scale + 0.5f);
+			write_block(index, quantised.data());
+		});
+
+		for (auto const& saved : saved_blocks)
+			write_block(saved.first, saved.second.data());
+	}
+	catch (agi::Exception const& e)
+	{
+		LOG_E("audio/renderer/spectrum") << "Failed to save spectrum data: " << e.GetMessage();
 	}
 }
 
@@ -170,43 +426,167 @@ void AudioSpectrumRenderer::FillBlock(size_t block_index, float *block)
 	assert(cache);
 	assert(block);
 
-	int64_t first_sample = (((int64_t)block_index) << derivation_dist) - ((int64_t)1 << derivation_size);
-	provider->GetInt16MonoAudio(audio_scratch.data(), first_sample, 2 << derivation_size);
+	auto saved = saved_blocks.find(block_index);
+	if (saved != saved_blocks.end())
+	{
+		for (auto value : saved->second)
+			*block++ = value / spectrum_quant_scale;
+		saved_blocks.erase(saved);
+		return;
+	}
+
+	auto computed = computed_blocks.find(block_index);
+	if (computed != computed_blocks.end())
+	{
+		std::copy(computed->second.begin(), computed->second.end(), block);
+		computed_blocks.erase(computed);
+		return;
+	}
+
+	// Draw silence until the real data arrives, and make sure it isn't saved
+	std::fill(block, block + ((size_t)1 << derivation_size), 0.f);
+	incomplete_blocks.insert(block_index);
+
+	// The block may have been aged out of the cache while being derived
+	dropped_blocks.erase(block_index);
+	if (!pending_blocks.count(block_index))
+	{
+		queued_blocks.push_back(block_index);
+		pending_blocks.insert(block_index);
+	}
+}
+
+void AudioSpectrumRenderer::DispatchBlocks()
+{
+	if (queued_blocks.empty())
+		return;
+
+	const size_t input_size = 2 << derivation_size;
+	const int64_t decoded = provider->GetDecodedSamples();
+#ifdef WITH_FFTW3
+	fftw_plan plan = GetPlan(derivation_size);
+#endif
+	auto renderer = self;
+
+	for (size_t first = 0; first < queued_blocks.size(); first += blocks_per_job)
+	{
+		const size_t count = std::min(blocks_per_job, queued_blocks.size() - first);
+		auto job = std::make_shared<AudioSpectrumJob>();
+		job->generation = generation;
+		job->derivation_size = derivation_size;
+		job->blocks.assign(queued_blocks.begin() + first, queued_blocks.begin() + first + count);
+		job->audio.resize(count * input_size);
+
+		// The provider can go away at any time, so read the audio here
+		for (size_t i = 0; i < count; ++i)
+		{
+			int64_t first_sample = (((int64_t)job->blocks[i]) << derivation_dist) - ((int64_t)1 << derivation_size);
+			provider->GetInt16MonoAudio(&job->audio[i * input_size], first_sample, input_size);
 
+			// Blocks computed from audio which hasn't been decoded yet are
+			// wrong and must not be saved
+			job->incomplete.push_back(first_sample + (int64_t)input_size > decoded && decoded < num_samples);
+		}
+
+		jobs.push_back(job);
+		agi::dispatch::Background().Async([=] {
+			if (!job->cancelled)
+			{
 #ifdef WITH_FFTW3
-	ConvertToFloat(2 << derivation_size, dft_input);
+				ComputeBlocks(*job, plan);
+#else
+				ComputeBlocks(*job);
+#endif
+				job->computed = true;
+			}
+			agi::dispatch::Main().Async([=] {
+				if (*renderer)
+					(*renderer)->OnBlocksComputed(*job);
+			});
+		});
+	}
 
-	fftw_execute(dft_plan);
+	queued_blocks.clear();
+}
 
-	double scale_factor = 9 / sqrt(2 << (derivation_size + 1));
+void AudioSpectrumRenderer::OnBlocksComputed(AudioSpectrumJob const& job)
+{
+	if (job.generation != generation || !cache)
+		return;
+
+	jobs.erase(std::remove_if(jobs.begin(), jobs.end(),
+		[&](std::shared_ptr<AudioSpectrumJob> const& j) { return j.get() == &job; }), jobs.end());
 
-	fftw_complex *o = dft_output;
-	for (size_t si = (size_t)1<<derivation_size; si > 0; --si)
+	if (!job.computed)
 	{
-		*block++ = log10( sqrt(o[0][0] * o[0][0] + o[0][1] * o[0][1]) * scale_factor + 1 );
-		o++;
+		// The placeholders are still in the cache, so the blocks have to be
+		// queued again if they're drawn again. The bitmaps they were drawn
+		// in need to be redrawn for that to happen.
+		for (size_t block_index : job.blocks)
+		{
+			pending_blocks.erase(block_index);
+			dropped_blocks.insert(block_index);
+		}
+		AnnounceUpdated();
+		return;
 	}
-#else
-	ConvertToFloat(2 << derivation_size, &fft_scratch[0]);
 
-	float *fft_input = &fft_scratch[0];
-	float *fft_real = &fft_scratch[0] + (2 << derivation_size);
-	float *fft_imag = &fft_scratch[0] + (4 << derivation_size);
+	const size_t block_size = (size_t)1 << derivation_size;
+	for (size_t i = 0; i < job.blocks.size(); ++i)
+	{
+		const size_t block_index = job.blocks[i];
+		pending_blocks.erase(block_index);
+		if (job.incomplete[i])
+			incomplete_blocks.insert(block_index);
+		else
+			incomplete_blocks.erase(block_index);
+
+		// If the block was aged out of the cache this puts it back, which
+		// FillBlock handles by taking the data from computed_blocks
+		auto power = job.power.begin() + i * block_size;
+		computed_blocks[block_index].assign(power, power + block_size);
+		bool created = false;
+		float *block = &cache->Get(block_index, &created);
+		if (!created)
+		{
+			std::copy(power, power + block_size, block);
+			computed_blocks.erase(block_index);
+		}
+	}
 
-	FFT fft;
-	fft.Transform(2<<derivation_size, fft_input, fft_real, fft_imag);
+	AnnounceUpdated();
+}
 
-	float scale_factor = 9 / sqrt(2 * (float)(2<<derivation_size));
+float *AudioSpectrumRenderer::GetBlock(size_t block_index)
+{
+	float *block = &cache->Get(block_index);
+	if (!dropped_blocks.empty() && dropped_blocks.erase(block_index) && !pending_blocks.count(block_index))
+	{
+		queued_blocks.push_back(block_index);
+		pending_blocks.insert(block_index);
+	}
+	return block;
+}
 
-	for (size_t si = 1<<derivation_size; si > 0; --si)
+void AudioSpectrumRenderer::SetVisibleRange(int start, int end)
+{
+	if (jobs.empty() || !provider)
+		return;
+
+	// Keep deriving blocks up to a screen's width to either side, as that's
+	// where the lookahead puts them and where scrolling is likely to go next
+	const int margin = end - start;
+	auto block_at = [&](int x) {
+		return (size_t)(std::max(x, 0) * pixel_ms * provider->GetSampleRate() / 1000) >> derivation_dist;
+	};
+	const size_t first = block_at(start - margin);
+	const size_t last = block_at(end + margin);
+
+	for (auto const& job : jobs)
 	{
-		// With x in range [0;1], log10(x*9+1) will also be in range [0;1],
-		// although the FFT output can apparently get greater magnitudes than 1
-		// despite the input being limited to [-1;+1).
-		*block++ = log10( sqrt(*fft_real * *fft_real + *fft_imag * *fft_imag) * scale_factor + 1 );
-		fft_real++; fft_imag++;
+		if (std::none_of(job->blocks.begin(), job->blocks.end(), [&](size_t b) { return b >= first && b <= last; }))
+			job->cancelled = true;
 	}
-#endif
 }
 
 void AudioSpectrumRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle style)
@@ -238,7 +618,7 @@ void AudioSpectrumRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 	{
 		// Derived audio data
 		size_t block_index = (size_t)(ax * pixel_ms * provider->GetSampleRate() / 1000) >> derivation_dist;
-		float *power = &cache->Get(block_index);
+		float *power = GetBlock(block_index);
 
 		// Prepare bitmap writing
 		unsigned char *px = imgdata + (imgheight-1) * stride + (ax - start) * 3;
@@ -276,6 +656,18 @@ void AudioSpectrumRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 		}
 	}
 
+	// Start deriving the blocks for the next bitmap's worth of columns as
+	// well, so that they're likely to be ready by the time they're scrolled to
+	const size_t block_count = (size_t)((num_samples + ((size_t)1<<derivation_dist) - 1) >> derivation_dist);
+	for (int ax = end; ax < end + bmp.GetWidth(); ++ax)
+	{
+		size_t block_index = (size_t)(ax * pixel_ms * provider->GetSampleRate() / 1000) >> derivation_dist;
+		if (block_index >= block_count) break;
+		GetBlock(block_index);
+	}
+
+	DispatchBlocks();
+
 	wxBitmap tmpbmp(img);
 	wxMemoryDC targetdc(bmp);
 	targetdc.DrawBitmap(tmpbmp, 0, 0);
@@ -292,6 +684,7 @@ void AudioSpectrumRenderer::RenderBlank(wxDC &dc, const wxRect &rect, AudioRende
 
 void AudioSpectrumRenderer::AgeCache(size_t max_size)
 {
+	cache_max_size = max_size;
 	if (cache)
 		cache->Age(max_size);
 }
@@ -35,23 +35,27 @@
 
 #include <cstdint>
 #include <memory>
+#include <set>
+#include <unordered_map>
 #include <vector>
 
 #include "audio_renderer.h"
 
-#ifdef WITH_FFTW3
-#include <fftw3.h>
-#endif
+#include <boost/filesystem/path.hpp>
 
 class AudioColorScheme;
 class AudioSpectrumCache;
 struct AudioSpectrumCacheBlockFactory;
+struct AudioSpectrumJob;
 
 /// @class AudioSpectrumRenderer
 /// @brief Render frequency-power spectrum graphs for audio data.
 ///
 /// Renders frequency-power spectrum graphs of PCM audio data using a derivation function
 /// such as the fast fourier transform.
+///
+/// The derivations are done in parallel on the background queue, and columns
+/// which have not been derived yet are drawn as silence until they are ready.
 class AudioSpectrumRenderer final : public AudioRendererBitmapProvider {
 	friend struct AudioSpectrumCacheBlockFactory;
 
@@ -82,28 +86,71 @@ class AudioSpectrumRenderer final : public AudioRendererBitmapProvider {
 	/// @brief Fill a block with frequency-power data for a time range
 	/// @param      block_index Index of the block to fill data for
 	/// @param[out] block       Address to write the data to
+	///
+	/// If the data isn't available yet, the block is filled with silence and
+	/// queued to be derived by DispatchBlocks().
 	void FillBlock(size_t block_index, float *block);
 
-	/// @brief Convert audio data to float range [-1;+1)
-	/// @param count Samples to convert
-	/// @param dest Buffer to fill
-	template<class T>
-	void ConvertToFloat(size_t count, T *dest);
-
-#ifdef WITH_FFTW3
-	/// FFTW plan data
-	fftw_plan dft_plan = nullptr;
-	/// Pre-allocated input array for FFTW
-	double *dft_input = nullptr;
-	/// Pre-allocated output array for FFTW
-	fftw_complex *dft_output = nullptr;
-#else
-	/// Pre-allocated scratch area for doing FFT derivations
-	std::vector<float> fft_scratch;
-#endif
-
-	/// Pre-allocated scratch area for storing raw audio data
-	std::vector<int16_t> audio_scratch;
+	/// Send off the queued blocks to be derived in the background
+	void DispatchBlocks();
+
+	/// Put the results of a background derivation into the cache
+	void OnBlocksComputed(AudioSpectrumJob const& job);
+
+	/// Get a block from the cache, queueing it if it was dropped earlier
+	float *GetBlock(size_t block_index);
+
+	/// Discard all derived data, including data still being derived
+	void DiscardBlocks();
+
+	/// Number of samples in the audio the cache is for
+	int64_t num_samples = 0;
+
+	/// Incremented whenever the derived data is discarded, so that the
+	/// results of derivations started before then can be recognised
+	uint64_t generation = 0;
+
+	/// Blocks filled with placeholder data which have not been dispatched yet
+	std::vector<size_t> queued_blocks;
+
+	/// Blocks which have been dispatched but whose results haven't arrived
+	std::set<size_t> pending_blocks;
+
+	/// Jobs which have been dispatched but whose results haven't arrived
+	std::vector<std::shared_ptr<AudioSpectrumJob>> jobs;
+
+	/// Blocks whose placeholders are in the cache but which were scrolled
+	/// away from before being derived, to be queued again when next drawn
+	std::set<size_t> dropped_blocks;
+
+	/// Derived blocks which have not yet been put into the cache
+	std::unordered_map<size_t, std::vector<float>> computed_blocks;
+
+	/// Pointer to this renderer shared with background derivations, which is
+	/// cleared when the renderer is destroyed. Only touched on the GUI thread.
+	std::shared_ptr<AudioSpectrumRenderer *> self;
+
+	/// Base path of the file to keep spectrum data in between sessions, if any
+	agi::fs::path summary_file;
+
+	/// Blocks saved by a previous session which have not been used yet,
+	/// quantised to 16 bits
+	std::unordered_map<size_t, std::vector<uint16_t>> saved_blocks;
+
+	/// Blocks in the cache which were computed before all of their audio was decoded
+	std::set<size_t> incomplete_blocks;
+
+	/// Most recent cache size limit, used to limit the size of the saved data
+	size_t cache_max_size = 0;
+
+	/// Get the filename for the saved data at the current resolution
+	agi::fs::path SummaryFilename() const;
+
+	/// Read the blocks saved for the current audio and resolution
+	void LoadSummary();
+
+	/// Save the blocks in the cache for the current audio and resolution
+	void SaveSummary();
 
 public:
 	/// @brief Constructor
@@ -133,6 +180,15 @@ public:
 	/// is specified too large, it will be clamped to the size.
 	void SetResolution(size_t derivation_size, size_t derivation_dist);
 
+	/// @brief Set the file to keep spectrum data in between sessions
+	/// @param file Base path to derive filenames from, or empty to not keep data
+	void SetSummaryFile(agi::fs::path const& file) override;
+
+	/// @brief Stop deriving blocks which are far from the visible audio
+	/// @param start First visible pixel
+	/// @param end   One past the last visible pixel
+	void SetVisibleRange(int start, int end) override;
+
 	/// @brief Cleans up the cache
 	/// @param max_size Maximum size in bytes for the cache
 	void AgeCache(size_t max_size) override;
@@ -32,6 +32,7 @@
 #include "audio_colorscheme.h"
 #include "options.h"
 
+#include <libaegisub/audio/peak_pyramid.h>
 #include <libaegisub/audio/provider.h>
 
 #include <algorithm>
@@ -83,27 +84,46 @@ void AudioWaveformRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 	wxPen pen_peaks(wxPen(pal->get(0.4f)));
 	wxPen pen_avgs(wxPen(pal->get(0.7f)));
 
+	// Use the precomputed summary when each column covers enough samples for
+	// it to be accurate, rather than scanning all of the samples every time
+	auto peaks = provider->GetPeakPyramid();
+	if (peaks && pixel_samples < agi::AudioPeakPyramid::BlockSize)
+		peaks = nullptr;
+
 	for (int x = 0; x < rect.width; ++x)
 	{
-		provider->GetInt16MonoAudio(reinterpret_cast<int16_t*>(audio_buffer.get()), (int64_t)cur_sample, (int64_t)pixel_samples);
-		cur_sample += pixel_samples;
-
 		int peak_min = 0, peak_max = 0;
 		int64_t avg_min_accum = 0, avg_max_accum = 0;
-		auto aud = reinterpret_cast<const int16_t *>(audio_buffer.get());
-		for (int si = pixel_samples; si > 0; --si, ++aud)
+
+		const int64_t first_sample = (int64_t)cur_sample;
+		if (peaks && first_sample + (int64_t)pixel_samples <= peaks->GetReadySamples())
 		{
-			if (*aud > 0)
-			{
-				peak_max = std::max(peak_max, (int)*aud);
-				avg_max_accum += *aud;
-			}
-			else
+			auto peak = peaks->GetPeak(first_sample, first_sample + (int64_t)pixel_samples);
+			peak_min = peak.min;
+			peak_max = peak.max;
+			avg_min_accum = (int64_t)(peak.avg_min * pixel_samples);
+			avg_max_accum = (int64_t)(peak.avg_max * pixel_samples);
+		}
+		else
+		{
+			provider->GetInt16MonoAudio(reinterpret_cast<int16_t*>(audio_buffer.get()), first_sample, (int64_t)pixel_samples);
+
+			auto aud = reinterpret_cast<const int16_t *>(audio_buffer.get());
+			for (int si = pixel_samples; si > 0; --si, ++aud)
 			{
-				peak_min = std::min(peak_min, (int)*aud);
-				avg_min_accum += *aud;
+				if (*aud > 0)
+				{
+					peak_max = std::max(peak_max, (int)*aud);
+					avg_max_accum += *aud;
+				}
+				else
+				{
+					peak_min = std::min(peak_min, (int)*aud);
+					avg_min_accum += *aud;
+				}
 			}
 		}
+		cur_sample += pixel_samples;
 
 		// midpoint is half height
 		peak_min = std::max((int)(peak_min * amplitude_scale * midpoint) / 0x8000, -midpoint);
@@ -128,6 +148,15 @@ void AudioWaveformRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 	dc.DrawLine(0, midpoint, rect.width, midpoint);
 }
 
+int64_t AudioWaveformRenderer::GetRenderableSamples() const
+{
+	int64_t samples = AudioRendererBitmapProvider::GetRenderableSamples();
+	auto peaks = provider ? provider->GetPeakPyramid() : nullptr;
+	if (peaks && pixel_ms * provider->GetSampleRate() / 1000.0 >= agi::AudioPeakPyramid::BlockSize)
+		samples = std::max(samples, peaks->GetReadySamples());
+	return samples;
+}
+
 void AudioWaveformRenderer::RenderBlank(wxDC &dc, const wxRect &rect, AudioRenderingStyle style)
 {
 	const AudioColorScheme *pal = &colors[style];
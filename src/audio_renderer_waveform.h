@@ -66,6 +66,12 @@ public:
 	/// @brief Render blank area
 	void RenderBlank(wxDC &dc, const wxRect &rect, AudioRenderingStyle style) override;
 
+	/// @brief Get the number of samples which can be rendered
+	///
+	/// Includes audio which has not been decoded yet if a saved summary of it
+	/// is available at the current zoom level.
+	int64_t GetRenderableSamples() const override;
+
 	/// @brief Cleans up the cache
 	/// @param max_size Maximum size in bytes for the cache
 	///
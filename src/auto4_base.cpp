@@ -48,6 +48,9 @@
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/trim.hpp>
 #include <future>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 
 #include <wx/dcmemory.h>
 #include <wx/log.h>
@@ -60,92 +63,226 @@
 #include <libaegisub/charset_conv_win.h>
 #endif
 
-namespace Automation4 {
-	bool CalculateTextExtents(AssStyle *style, std::string const& text, double &width, double &height, double &descent, double &extlead)
-	{
-		width = height = descent = extlead = 0;
+namespace {
+	/// Extents of a piece of text as reported by the platform
+	struct text_extents {
+		int width;
+		int height;
+		int descent;
+		int extlead;
+	};
+
+	/// Everything about a style which affects how text is measured
+	struct font_key {
+		std::string face;
+		double size;
+		bool bold;
+		bool italic;
+		bool underline;
+		bool strikeout;
+		int encoding;
+
+		bool operator==(font_key const& rgt) const {
+			return face == rgt.face && size == rgt.size && bold == rgt.bold
+				&& italic == rgt.italic && underline == rgt.underline
+				&& strikeout == rgt.strikeout && encoding == rgt.encoding;
+		}
+	};
+
+	/// A font ready for measuring text, along with the extents of the text
+	/// and individual characters measured with it so far
+	///
+	/// Karaoke templates measure the same few styles and syllables over and
+	/// over, so keeping these around turns most measurements into lookups.
+	class text_measurer {
+#ifdef WIN32
+		HDC dc = nullptr;
+		HFONT font = nullptr;
+		HGDIOBJ old_font = nullptr;
+#else
+		wxMemoryDC dc;
+		wxFont font;
+#endif
+		std::unordered_map<uint32_t, text_extents> glyphs;
+		std::unordered_map<std::string, text_extents> strings;
 
-		double fontsize = style->fontsize * 64;
-		double spacing = style->spacing * 64;
+	public:
+		/// Metrics of the font as a whole
+		int descent = 0;
+		int extlead = 0;
 
+		text_measurer(font_key const& key);
+		~text_measurer();
+		bool IsOk() const;
+
+		text_extents const& Glyph(uint32_t c);
+		text_extents const& Text(std::string const& text);
+	};
+
+	// This is almost copypasta from TextSub
+	text_measurer::text_measurer(font_key const& key) {
 #ifdef WIN32
-		// This is almost copypasta from TextSub
-		auto dc = CreateCompatibleDC(nullptr);
-		if (!dc) return false;
+		dc = CreateCompatibleDC(nullptr);
+		if (!dc) return;
 
 		SetMapMode(dc, MM_TEXT);
 
 		LOGFONTW lf = {0};
-		lf.lfHeight = (LONG)fontsize;
-		lf.lfWeight = style->bold ? FW_BOLD : FW_NORMAL;
-		lf.lfItalic = style->italic;
-		lf.lfUnderline = style->underline;
-		lf.lfStrikeOut = style->strikeout;
-		lf.lfCharSet = style->encoding;
+		lf.lfHeight = (LONG)key.size;
+		lf.lfWeight = key.bold ? FW_BOLD : FW_NORMAL;
+		lf.lfItalic = key.italic;
+		lf.lfUnderline = key.underline;
+		lf.lfStrikeOut = key.strikeout;
+		lf.lfCharSet = key.encoding;
 		lf.lfOutPrecision = OUT_TT_PRECIS;
 		lf.lfClipPrecision = CLIP_DEFAULT_PRECIS;
 		lf.lfQuality = ANTIALIASED_QUALITY;
 		lf.lfPitchAndFamily = DEFAULT_PITCH|FF_DONTCARE;
-		wcsncpy(lf.lfFaceName, agi::charset::ConvertW(style->font).c_str(), 31);
-
-		auto font = CreateFontIndirect(&lf);
-		if (!font) return false;
+		wcsncpy(lf.lfFaceName, agi::charset::ConvertW(key.face).c_str(), 31);
 
-		auto old_font = SelectObject(dc, font);
+		font = CreateFontIndirect(&lf);
+		if (!font) return;
 
-		std::wstring wtext(agi::charset::ConvertW(text));
-		if (spacing != 0 ) {
-			width = 0;
-			for (auto c : wtext) {
-				SIZE sz;
-				GetTextExtentPoint32(dc, &c, 1, &sz);
-				width += sz.cx + spacing;
-				height = sz.cy;
-			}
-		}
-		else {
-			SIZE sz;
-			GetTextExtentPoint32(dc, &wtext[0], (int)wtext.size(), &sz);
-			width = sz.cx;
-			height = sz.cy;
-		}
+		old_font = SelectObject(dc, font);
 
 		TEXTMETRIC tm;
 		GetTextMetrics(dc, &tm);
 		descent = tm.tmDescent;
 		extlead = tm.tmExternalLeading;
-
-		SelectObject(dc, old_font);
-		DeleteObject(font);
-		DeleteObject(dc);
-
-#else // not WIN32
-		wxMemoryDC thedc;
-
+#else
 		// fix fontsize to be 72 DPI
 		//fontsize = -FT_MulDiv((int)(fontsize+0.5), 72, thedc.GetPPI().y);
 
-		// now try to get a font!
-		// use the font list to get some caching... (chance is the script will need the same font very often)
 		// USING wxTheFontList SEEMS TO CAUSE BAD LEAKS!
-		//wxFont *thefont = wxTheFontList->FindOrCreateFont(
-		wxFont thefont(
-			(int)fontsize,
+		font = wxFont(
+			(int)key.size,
 			wxFONTFAMILY_DEFAULT,
-			style->italic ? wxFONTSTYLE_ITALIC : wxFONTSTYLE_NORMAL,
-			style->bold ? wxFONTWEIGHT_BOLD : wxFONTWEIGHT_NORMAL,
-			style->underline,
-			to_wx(style->font),
+			key.italic ? wxFONTSTYLE_ITALIC : wxFONTSTYLE_NORMAL,
+			key.bold ? wxFONTWEIGHT_BOLD : wxFONTWEIGHT_NORMAL,
+			key.underline,
+			to_wx(key.face),
 			wxFONTENCODING_SYSTEM); // FIXME! make sure to get the right encoding here, make some translation table between windows and wx encodings
-		thedc.SetFont(thefont);
+		dc.SetFont(font);
+#endif
+	}
+
+	text_measurer::~text_measurer() {
+#ifdef WIN32
+		if (old_font) SelectObject(dc, old_font);
+		if (font) DeleteObject(font);
+		if (dc) DeleteDC(dc);
+#endif
+	}
 
-		wxString wtext(to_wx(text));
+	bool text_measurer::IsOk() const {
+#ifdef WIN32
+		return font != nullptr;
+#else
+		return true;
+#endif
+	}
+
+	text_extents const& text_measurer::Glyph(uint32_t c) {
+		auto it = glyphs.find(c);
+		if (it != glyphs.end()) return it->second;
+
+		text_extents e = {0, 0, descent, extlead};
+#ifdef WIN32
+		wchar_t wc = (wchar_t)c;
+		SIZE sz;
+		GetTextExtentPoint32(dc, &wc, 1, &sz);
+		e.width = sz.cx;
+		e.height = sz.cy;
+#else
+		dc.GetTextExtent(wxString(wxUniChar(c)), &e.width, &e.height, &e.descent, &e.extlead);
+#endif
+		return glyphs.emplace(c, e).first->second;
+	}
+
+	text_extents const& text_measurer::Text(std::string const& text) {
+		auto it = strings.find(text);
+		if (it != strings.end()) return it->second;
+
+		// Scripts which measure generated text could otherwise grow this forever
+		if (strings.size() > 10000)
+			strings.clear();
+
+		text_extents e = {0, 0, descent, extlead};
+#ifdef WIN32
+		std::wstring wtext(agi::charset::ConvertW(text));
+		SIZE sz;
+		GetTextExtentPoint32(dc, &wtext[0], (int)wtext.size(), &sz);
+		e.width = sz.cx;
+		e.height = sz.cy;
+#else
+		dc.GetTextExtent(to_wx(text), &e.width, &e.height, &e.descent, &e.extlead);
+#endif
+		return strings.emplace(text, e).first->second;
+	}
+
+	std::mutex measurer_mutex;
+
+	/// Get a measurer for the font, reusing one of the recently used ones if possible
+	text_measurer *get_measurer(font_key const& key) {
+		// Leaked deliberately, as destroying fonts after wx has shut down crashes
+		static auto measurers = new std::list<std::pair<font_key, std::unique_ptr<text_measurer>>>;
+		static const size_t max_measurers = 16;
+
+		auto it = find_if(begin(*measurers), end(*measurers), [&](std::pair<font_key, std::unique_ptr<text_measurer>> const& m) {
+			return m.first == key;
+		});
+		if (it != end(*measurers)) {
+			measurers->splice(begin(*measurers), *measurers, it);
+			return measurers->front().second.get();
+		}
+
+		auto measurer = agi::make_unique<text_measurer>(key);
+		if (!measurer->IsOk()) return nullptr;
+
+		measurers->emplace_front(key, std::move(measurer));
+		if (measurers->size() > max_measurers)
+			measurers->pop_back();
+		return measurers->front().second.get();
+	}
+}
+
+namespace Automation4 {
+	bool CalculateTextExtents(AssStyle *style, std::string const& text, double &width, double &height, double &descent, double &extlead)
+	{
+		width = height = descent = extlead = 0;
+
+		double fontsize = style->fontsize * 64;
+		double spacing = style->spacing * 64;
+
+		std::lock_guard<std::mutex> lock(measurer_mutex);
+		text_measurer *measurer = get_measurer(font_key{
+			style->font, fontsize, style->bold, style->italic,
+			style->underline, style->strikeout, style->encoding});
+		if (!measurer) return false;
+
+#ifdef WIN32
+		if (spacing != 0 ) {
+			for (auto c : agi::charset::ConvertW(text)) {
+				auto const& sz = measurer->Glyph(c);
+				width += sz.width + spacing;
+				height = sz.height;
+			}
+		}
+		else {
+			auto const& sz = measurer->Text(text);
+			width = sz.width;
+			height = sz.height;
+		}
+
+		descent = measurer->descent;
+		extlead = measurer->extlead;
+#else // not WIN32
 		if (spacing) {
 			// If there's inter-character spacing, kerning info must not be used, so calculate width per character
 			// NOTE: Is kerning actually done either way?!
-			for (auto const& wc : wtext) {
-				int a, b, c, d;
-				thedc.GetTextExtent(wc, &a, &b, &c, &d);
+			for (auto const& wc : to_wx(text)) {
+				auto const& e = measurer->Glyph(wxUniChar(wc).GetValue());
+				int a = e.width, b = e.height, c = e.descent, d = e.extlead;
 				double scaling = fontsize / (double)(b > 0 ? b : 1); // semi-workaround for missing OS/2 table data for scaling
 				width += (a + spacing)*scaling;
 				height = b > height ? b*scaling : height;
@@ -154,10 +291,9 @@ namespace Automation4 {
 			}
 		} else {
 			// If the inter-character spacing should be zero, kerning info can (and must) be used, so calculate everything in one go
-			wxCoord lwidth, lheight, ldescent, lextlead;
-			thedc.GetTextExtent(wtext, &lwidth, &lheight, &ldescent, &lextlead);
-			double scaling = fontsize / (double)(lheight > 0 ? lheight : 1); // semi-workaround for missing OS/2 table data for scaling
-			width = lwidth*scaling; height = lheight*scaling; descent = ldescent*scaling; extlead = lextlead*scaling;
+			auto const& e = measurer->Text(text);
+			double scaling = fontsize / (double)(e.height > 0 ? e.height : 1); // semi-workaround for missing OS/2 table data for scaling
+			width = e.width*scaling; height = e.height*scaling; descent = e.descent*scaling; extlead = e.extlead*scaling;
 		}
 #endif
 
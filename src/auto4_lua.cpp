@@ -55,6 +55,7 @@
 
 #include <libaegisub/dispatch.h>
 #include <libaegisub/format.h>
+#include <libaegisub/log.h>
 #include <libaegisub/lua/ffi.h>
 #include <libaegisub/lua/modules.h>
 #include <libaegisub/lua/script_reader.h>
@@ -68,6 +69,7 @@
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/scope_exit.hpp>
 #include <cassert>
+#include <chrono>
 #include <mutex>
 #include <wx/clipbrd.h>
 #include <wx/log.h>
@@ -341,6 +343,33 @@ namespace {
 		wxString help;
 		int cmd_type;
 
+		/// Everything which a validation function's result is assumed to
+		/// depend on, so that it only needs to be called when one changes
+		struct validation_key {
+			const agi::Context *context = nullptr;
+			int commit_id = 0;
+			int selection_generation = 0;
+			const AssDialogue *active_line = nullptr;
+			const void *audio_provider = nullptr;
+			const void *video_provider = nullptr;
+			int video_frame = 0;
+			int macro_runs = 0;
+
+			validation_key() = default;
+			validation_key(const agi::Context *c);
+			bool operator==(validation_key const& rgt) const;
+		};
+
+		/// Cached result of the last call to a validation function
+		struct validation_result {
+			validation_key key;
+			bool valid = false;
+			bool result = false;
+		};
+
+		validation_result validate_cache;
+		validation_result active_cache;
+
 	public:
 		LuaCommand(lua_State *L);
 		~LuaCommand();
@@ -455,6 +484,7 @@ namespace {
 			lua_pop(L, 1);
 			return;
 		}
+		EnableBytecodeCache(L, config::path->Decode("?local/automation_cache"));
 		stackcheck.check_stack(0);
 
 		// prepare stuff in the registry
@@ -732,15 +762,55 @@ namespace {
 		LuaScript::GetScriptObject(L)->UnregisterCommand(this);
 	}
 
+	/// Number of times any macro or export filter has been run, as they may
+	/// change state in their script which validation functions depend on
+	static int macro_run_count = 0;
+
+	LuaCommand::validation_key::validation_key(const agi::Context *c)
+	: context(c)
+	, commit_id(c->subsController->CommitId())
+	, selection_generation(c->selectionController->Generation())
+	, active_line(c->selectionController->GetActiveLine())
+	, audio_provider(c->project->AudioProvider())
+	, video_provider(c->project->VideoProvider())
+	, video_frame(c->videoController->GetFrameN())
+	, macro_runs(macro_run_count)
+	{
+	}
+
+	bool LuaCommand::validation_key::operator==(validation_key const& rgt) const
+	{
+		return context == rgt.context
+			&& commit_id == rgt.commit_id
+			&& selection_generation == rgt.selection_generation
+			&& active_line == rgt.active_line
+			&& audio_provider == rgt.audio_provider
+			&& video_provider == rgt.video_provider
+			&& video_frame == rgt.video_frame
+			&& macro_runs == rgt.macro_runs;
+	}
+
+	/// Log how long a validation function took to run, making slow ones
+	/// stand out since they're run every time a menu is opened
+	static void log_validation_time(std::string const& name, const char *function, std::chrono::steady_clock::time_point start)
+	{
+		using namespace std::chrono;
+		auto ms = duration_cast<milliseconds>(steady_clock::now() - start).count();
+		if (ms >= 100)
+			LOG_W("automation/lua/validate") << name << ": " << function << " function took " << ms << " ms";
+		else
+			LOG_D("automation/lua/validate") << name << ": " << function << " function took " << ms << " ms";
+	}
+
 	static std::vector<int> selected_rows(const agi::Context *c)
 	{
 		auto const& sel = c->selectionController->GetSelectedSet();
 		int offset = c->ass->Info.size() + c->ass->Styles.size();
 		std::vector<int> rows;
 		rows.reserve(sel.size());
+		// The selection is iterated in row order, so this is already sorted
 		for (auto line : sel)
 			rows.push_back(line->Row + offset + 1);
-		sort(begin(rows), end(rows));
 		return rows;
 	}
 
@@ -748,6 +818,14 @@ namespace {
 	{
 		if (!(cmd_type & cmd::COMMAND_VALIDATE)) return true;
 
+		validation_key key(c);
+		if (validate_cache.valid && validate_cache.key == key)
+			return validate_cache.result;
+		validate_cache.key = key;
+		validate_cache.valid = true;
+		validate_cache.result = false;
+
+		auto start = std::chrono::steady_clock::now();
 		set_context(L, c);
 
 		// Error handler goes under the function to call
@@ -764,6 +842,7 @@ namespace {
 
 		int err = lua_pcall(L, 3, 2, -5 /* three args, function, error handler */);
 		subsobj->ProcessingComplete();
+		log_validation_time(cmd_name, "validation", start);
 
 		if (err) {
 			wxLogWarning("Runtime error in Lua macro validation function:\n%s", get_wxstring(L, -1));
@@ -772,6 +851,7 @@ namespace {
 		}
 
 		bool result = !!lua_toboolean(L, -2);
+		validate_cache.result = result;
 
 		wxString new_help_string(get_wxstring(L, -1));
 		if (new_help_string.size()) {
@@ -786,6 +866,7 @@ namespace {
 
 	void LuaCommand::operator()(agi::Context *c)
 	{
+		++macro_run_count;
 		LuaStackcheck stackcheck(L);
 		set_context(L, c);
 		stackcheck.check_stack(0);
@@ -830,7 +911,7 @@ namespace {
 
 		// top of stack will be selected lines array, if any was returned
 		if (lua_istable(L, -1)) {
-			std::set<AssDialogue*> sel;
+			Selection sel;
 			lua_for_each(L, [&] {
 				if (!lua_isnumber(L, -1))
 					return;
@@ -851,8 +932,10 @@ namespace {
 					active_line = diag;
 			});
 
+			// The old active line may have been deleted by the macro, so it
+			// has to be compared by address rather than looked up by row
 			AssDialogue *new_active = c->selectionController->GetActiveLine();
-			if (active_line && (active_idx > 0 || !sel.count(new_active)))
+			if (active_line && (active_idx > 0 || std::find(sel.begin(), sel.end(), new_active) == sel.end()))
 				new_active = active_line;
 			if (sel.empty())
 				sel.insert(new_active);
@@ -891,6 +974,11 @@ namespace {
 	{
 		if (!(cmd_type & cmd::COMMAND_TOGGLE)) return false;
 
+		validation_key key(c);
+		if (active_cache.valid && active_cache.key == key)
+			return active_cache.result;
+
+		auto start = std::chrono::steady_clock::now();
 		LuaStackcheck stackcheck(L);
 
 		set_context(L, c);
@@ -904,6 +992,7 @@ namespace {
 
 		int err = lua_pcall(L, 3, 1, 0);
 		subsobj->ProcessingComplete();
+		log_validation_time(cmd_name, "IsActive", start);
 
 		bool result = false;
 		if (err)
@@ -911,6 +1000,10 @@ namespace {
 		else
 			result = !!lua_toboolean(L, -1);
 
+		active_cache.key = key;
+		active_cache.valid = true;
+		active_cache.result = result;
+
 		// clean up stack (result or error message)
 		stackcheck.check_stack(1);
 		lua_pop(L, 1);
@@ -959,6 +1052,7 @@ namespace {
 
 	void LuaExportFilter::ProcessSubs(AssFile *subs, wxWindow *export_dialog)
 	{
+		++macro_run_count;
 		LuaStackcheck stackcheck(L);
 
 		GetFeatureFunction("run");
@@ -1028,6 +1122,11 @@ namespace Automation4 {
 	LuaScriptFactory::LuaScriptFactory()
 	: ScriptFactory("Lua", "*.lua,*.moon")
 	{
+		// Compiled scripts are never overwritten as they're keyed on the
+		// modification time, so clear out old ones from time to time
+		auto cache_dir = config::path->Decode("?local/automation_cache");
+		if (agi::fs::DirectoryExists(cache_dir))
+			CleanCache(cache_dir, "*.luac", 64, 2000);
 	}
 
 	std::unique_ptr<Script> LuaScriptFactory::Produce(agi::fs::path const& filename) const
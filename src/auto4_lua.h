@@ -33,6 +33,7 @@
 #include <vector>
 #include <wx/string.h>
 
+class AssDialogue;
 class AssEntry;
 class wxControl;
 class wxWindow;
@@ -58,6 +59,9 @@ namespace Automation4 {
 		bool can_modify;
 		/// Is the feature allowed to set undo points?
 		bool can_set_undo;
+		/// Is subs.apply currently running? Other modifications aren't
+		/// allowed while it is.
+		bool applying = false;
 		/// throws an error if modification is disallowed
 		void CheckAllowModify();
 		/// throws an error if the line index is out of bounds
@@ -91,6 +95,8 @@ namespace Automation4 {
 		/// Set the line at the index to the given value
 		void AssignLine(size_t idx, std::unique_ptr<AssEntry> e);
 		void InsertLine(std::vector<AssEntry *> &vec, size_t idx, std::unique_ptr<AssEntry> e);
+		/// Convert the line or list of lines at idx and append them to vec
+		void LuaToLines(lua_State *L, int idx, std::vector<AssEntry *> &vec);
 
 		int ObjectIndexRead(lua_State *L);
 		void ObjectIndexWrite(lua_State *L);
@@ -99,9 +105,25 @@ namespace Automation4 {
 		void ObjectDeleteRange(lua_State *L);
 		void ObjectAppend(lua_State *L);
 		void ObjectInsert(lua_State *L);
+		void ObjectReplaceRange(lua_State *L);
+		void ObjectApply(lua_State *L);
 		void ObjectGarbageCollect(lua_State *L);
 		int ObjectIPairs(lua_State *L);
 		int IterNext(lua_State *L);
+		int ObjectLazy(lua_State *L);
+		int ObjectLazyIPairs(lua_State *L);
+		int LazyIterNext(lua_State *L);
+
+		/// Makes a lazy Lua representation of the line at idx and places it
+		/// on the top of the stack. Dialogue lines become tables which only
+		/// convert each field when it's first read; other lines are
+		/// converted as normal. The file object must be upvalue 1.
+		void LazyEntryToLua(lua_State *L, size_t idx);
+		/// Get the line a lazy line table at idx was made from, or nullptr
+		/// if it isn't one
+		static const AssDialogue *GetLazyLine(lua_State *L, int idx, LuaAssFile **file);
+		/// __index metamethod for lazy lines
+		static int LazyLineIndex(lua_State *L);
 
 		int LuaParseKaraokeData(lua_State *L);
 		int LuaGetScriptResolution(lua_State *L);
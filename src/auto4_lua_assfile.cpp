@@ -50,6 +50,7 @@
 #include <boost/algorithm/string/case_conv.hpp>
 #include <cassert>
 #include <memory>
+#include <unordered_set>
 
 namespace {
 	using namespace agi::lua;
@@ -128,6 +129,67 @@ namespace {
 	const T *check_cast_constptr(const U *value) {
 		return typeid(const T) == typeid(*value) ? static_cast<const T *>(value) : nullptr;
 	}
+
+	bool has_raw_field(lua_State *L, const char *name)
+	{
+		lua_pushstring(L, name);
+		lua_rawget(L, -2);
+		bool ret = !lua_isnil(L, -1);
+		lua_pop(L, 1);
+		return ret;
+	}
+
+	std::vector<uint32_t> read_extradata(lua_State *L, AssFile *ass)
+	{
+		std::vector<uint32_t> new_ids;
+
+		lua_getfield(L, -1, "extra");
+		auto type = lua_type(L, -1);
+		if (type == LUA_TTABLE) {
+			lua_for_each(L, [&] {
+				if (lua_type(L, -2) != LUA_TSTRING) return;
+				new_ids.push_back(ass->AddExtradata(
+					get_string_or_default(L, -2),
+					get_string_or_default(L, -1)));
+			});
+			std::sort(begin(new_ids), end(new_ids));
+		}
+		else if (type != LUA_TNIL) {
+			error(L, "dialogue extradata must be a table");
+		}
+
+		return new_ids;
+	}
+
+	/// The fields of a dialogue line's Lua representation, shared by the
+	/// eagerly filled tables and the lazy ones which fill themselves in on
+	/// first access
+	struct dialogue_field {
+		const char *name;
+		void (*push)(lua_State *L, AssFile *ass, const AssDialogue *dia);
+	} const dialogue_fields[] = {
+		{"raw", [](lua_State *L, AssFile *, const AssDialogue *dia) { push_value(L, dia->GetEntryData()); }},
+		{"comment", [](lua_State *L, AssFile *, const AssDialogue *dia) { push_value(L, dia->Comment); }},
+		{"layer", [](lua_State *L, AssFile *, const AssDialogue *dia) { push_value(L, dia->Layer); }},
+		{"start_time", [](lua_State *L, AssFile *, const AssDialogue *dia) { push_value(L, dia->Start); }},
+		{"end_time", [](lua_State *L, AssFile *, const AssDialogue *dia) { push_value(L, dia->End); }},
+		{"style", [](lua_State *L, AssFile *, const AssDialogue *dia) { push_value(L, dia->Style); }},
+		{"actor", [](lua_State *L, AssFile *, const AssDialogue *dia) { push_value(L, dia->Actor); }},
+		{"effect", [](lua_State *L, AssFile *, const AssDialogue *dia) { push_value(L, dia->Effect); }},
+		{"margin_l", [](lua_State *L, AssFile *, const AssDialogue *dia) { push_value(L, dia->Margin[0]); }},
+		{"margin_r", [](lua_State *L, AssFile *, const AssDialogue *dia) { push_value(L, dia->Margin[1]); }},
+		{"margin_t", [](lua_State *L, AssFile *, const AssDialogue *dia) { push_value(L, dia->Margin[2]); }},
+		{"margin_b", [](lua_State *L, AssFile *, const AssDialogue *dia) { push_value(L, dia->Margin[2]); }},
+		{"text", [](lua_State *L, AssFile *, const AssDialogue *dia) { push_value(L, dia->Text); }},
+		{"extra", [](lua_State *L, AssFile *ass, const AssDialogue *dia) {
+			lua_newtable(L);
+			for (auto const& ed : ass->GetExtradata(dia->ExtradataIds)) {
+				push_value(L, ed.key);
+				push_value(L, ed.value);
+				lua_settable(L, -3);
+			}
+		}},
+	};
 }
 
 namespace Automation4 {
@@ -137,6 +199,8 @@ namespace Automation4 {
 	{
 		if (!can_modify)
 			error(L, "Attempt to modify subtitles in read-only feature context.");
+		if (applying)
+			error(L, "Attempt to modify subtitles from inside subs.apply.");
 	}
 
 	void LuaAssFile::CheckBounds(int idx)
@@ -162,34 +226,10 @@ namespace Automation4 {
 			set_field(L, "class", "info");
 		}
 		else if (auto dia = check_cast_constptr<AssDialogue>(e)) {
-			set_field(L, "raw", dia->GetEntryData());
-			set_field(L, "comment", dia->Comment);
-
-			set_field(L, "layer", dia->Layer);
-
-			set_field(L, "start_time", dia->Start);
-			set_field(L, "end_time", dia->End);
-
-			set_field(L, "style", dia->Style);
-			set_field(L, "actor", dia->Actor);
-			set_field(L, "effect", dia->Effect);
-
-			set_field(L, "margin_l", dia->Margin[0]);
-			set_field(L, "margin_r", dia->Margin[1]);
-			set_field(L, "margin_t", dia->Margin[2]);
-			set_field(L, "margin_b", dia->Margin[2]);
-
-			set_field(L, "text", dia->Text);
-
-			// create extradata table
-			lua_newtable(L);
-			for (auto const& ed : ass->GetExtradata(dia->ExtradataIds)) {
-				push_value(L, ed.key);
-				push_value(L, ed.value);
-				lua_settable(L, -3);
+			for (auto const& field : dialogue_fields) {
+				field.push(L, ass, dia);
+				lua_setfield(L, -2, field.name);
 			}
-			lua_setfield(L, -2, "extra");
-
 			set_field(L, "class", "dialogue");
 		}
 		else if (auto sty = check_cast_constptr<AssStyle>(e)) {
@@ -238,6 +278,75 @@ namespace Automation4 {
 		}
 	}
 
+	void LuaAssFile::LazyEntryToLua(lua_State *L, size_t idx)
+	{
+		auto dia = lines[idx] ? check_cast_constptr<AssDialogue>(lines[idx]) : nullptr;
+		if (!dia) {
+			AssEntryToLua(L, idx);
+			return;
+		}
+
+		lua_createtable(L, 0, 4);
+		set_field(L, "section", dia->GroupHeader());
+		set_field(L, "class", "dialogue");
+
+		// The metatable holds on to the file object both so that the line
+		// can't outlive it and so that we can check that it's still valid
+		// before touching the line
+		lua_createtable(L, 0, 3);
+		lua_pushvalue(L, lua_upvalueindex(1));
+		lua_setfield(L, -2, "__subs");
+		lua_pushlightuserdata(L, const_cast<AssDialogue *>(dia));
+		lua_setfield(L, -2, "__line");
+		lua_pushcfunction(L, LazyLineIndex);
+		lua_setfield(L, -2, "__index");
+		lua_setmetatable(L, -2);
+	}
+
+	const AssDialogue *LuaAssFile::GetLazyLine(lua_State *L, int idx, LuaAssFile **file)
+	{
+		if (!lua_getmetatable(L, idx))
+			return nullptr;
+
+		lua_getfield(L, -1, "__line");
+		lua_getfield(L, -2, "__subs");
+		if (!lua_islightuserdata(L, -2) || !lua_isuserdata(L, -1)) {
+			lua_pop(L, 3);
+			return nullptr;
+		}
+
+		*file = GetObjPointer(L, -1, false);
+		auto dia = static_cast<const AssDialogue *>(lua_touserdata(L, -2));
+		lua_pop(L, 3);
+		return dia;
+	}
+
+	int LuaAssFile::LazyLineIndex(lua_State *L)
+	{
+		if (lua_type(L, 2) != LUA_TSTRING)
+			return 0;
+
+		LuaAssFile *file;
+		auto dia = GetLazyLine(L, 1, &file);
+		if (!dia)
+			return 0;
+
+		const char *name = lua_tostring(L, 2);
+		for (auto const& field : dialogue_fields) {
+			if (strcmp(name, field.name) != 0) continue;
+
+			// Store the value in the line so that later reads don't come
+			// back here and modifications by the script stick
+			field.push(L, file->ass, dia);
+			lua_pushvalue(L, 2);
+			lua_pushvalue(L, -2);
+			lua_rawset(L, 1);
+			return 1;
+		}
+
+		return 0;
+	}
+
 	std::unique_ptr<AssEntry> LuaAssFile::LuaToAssEntry(lua_State *L, AssFile *ass)
 	{
 		// assume an assentry table is on the top of the stack
@@ -287,6 +396,42 @@ namespace Automation4 {
 		}
 		else if (lclass == "dialogue") {
 			assert(ass != 0); // since we need AssFile::AddExtradata
+
+			// Lazy lines only need the fields which have been read or
+			// written applied on top of the line they came from
+			LuaAssFile *file;
+			auto lazy = GetLazyLine(L, -1, &file);
+			if (lazy && file->ass == ass) {
+				auto dia = new AssDialogue(*lazy);
+				result.reset(dia);
+
+				if (has_raw_field(L, "comment"))
+					dia->Comment = get_bool_field(L, "comment", "dialogue");
+				if (has_raw_field(L, "layer"))
+					dia->Layer = get_int_field(L, "layer", "dialogue");
+				if (has_raw_field(L, "start_time"))
+					dia->Start = get_int_field(L, "start_time", "dialogue");
+				if (has_raw_field(L, "end_time"))
+					dia->End = get_int_field(L, "end_time", "dialogue");
+				if (has_raw_field(L, "style"))
+					dia->Style = get_string_field(L, "style", "dialogue");
+				if (has_raw_field(L, "actor"))
+					dia->Actor = get_string_field(L, "actor", "dialogue");
+				if (has_raw_field(L, "margin_l"))
+					dia->Margin[0] = get_int_field(L, "margin_l", "dialogue");
+				if (has_raw_field(L, "margin_r"))
+					dia->Margin[1] = get_int_field(L, "margin_r", "dialogue");
+				if (has_raw_field(L, "margin_t"))
+					dia->Margin[2] = get_int_field(L, "margin_t", "dialogue");
+				if (has_raw_field(L, "effect"))
+					dia->Effect = get_string_field(L, "effect", "dialogue");
+				if (has_raw_field(L, "text"))
+					dia->Text = get_string_field(L, "text", "dialogue");
+				if (has_raw_field(L, "extra"))
+					dia->ExtradataIds = read_extradata(L, ass);
+				return result;
+			}
+
 			auto dia = new AssDialogue;
 			result.reset(dia);
 
@@ -301,24 +446,7 @@ namespace Automation4 {
 			dia->Margin[2] = get_int_field(L, "margin_t", "dialogue");
 			dia->Effect = get_string_field(L, "effect", "dialogue");
 			dia->Text = get_string_field(L, "text", "dialogue");
-
-			std::vector<uint32_t> new_ids;
-
-			lua_getfield(L, -1, "extra");
-			auto type = lua_type(L, -1);
-			if (type == LUA_TTABLE) {
-				lua_for_each(L, [&] {
-					if (lua_type(L, -2) != LUA_TSTRING) return;
-					new_ids.push_back(ass->AddExtradata(
-						get_string_or_default(L, -2),
-						get_string_or_default(L, -1)));
-				});
-				std::sort(begin(new_ids), end(new_ids));
-				dia->ExtradataIds = std::move(new_ids);
-			}
-			else if (type != LUA_TNIL) {
-				error(L, "dialogue extradata must be a table");
-			}
+			dia->ExtradataIds = read_extradata(L, ass);
 		}
 		else {
 			error(L, "Found line with unknown class: %s", lclass.c_str());
@@ -360,8 +488,16 @@ namespace Automation4 {
 					lua_pushcclosure(L, closure_wrapper_v<&LuaAssFile::ObjectInsert, false>, 1);
 				else if (strcmp(idx, "append") == 0)
 					lua_pushcclosure(L, closure_wrapper_v<&LuaAssFile::ObjectAppend, false>, 1);
+				else if (strcmp(idx, "replace_range") == 0)
+					lua_pushcclosure(L, closure_wrapper_v<&LuaAssFile::ObjectReplaceRange, false>, 1);
+				else if (strcmp(idx, "apply") == 0)
+					lua_pushcclosure(L, closure_wrapper_v<&LuaAssFile::ObjectApply, false>, 1);
 				else if (strcmp(idx, "script_resolution") == 0)
 					lua_pushcclosure(L, closure_wrapper<&LuaAssFile::LuaGetScriptResolution>, 1);
+				else if (strcmp(idx, "lazy") == 0)
+					lua_pushcclosure(L, closure_wrapper<&LuaAssFile::ObjectLazy>, 1);
+				else if (strcmp(idx, "lazy_ipairs") == 0)
+					lua_pushcclosure(L, closure_wrapper<&LuaAssFile::ObjectLazyIPairs>, 1);
 				else {
 					// idiot
 					lua_pop(L, 1);
@@ -533,34 +669,74 @@ namespace Automation4 {
 		lines.erase(lines.begin() + a, lines.begin() + b);
 	}
 
-	void LuaAssFile::ObjectAppend(lua_State *L)
+	void LuaAssFile::LuaToLines(lua_State *L, int idx, std::vector<AssEntry *> &vec)
 	{
-		CheckAllowModify();
+		int top = lua_gettop(L);
+
+		// A table without a class is a list of lines rather than a line
+		bool is_list = false;
+		if (lua_istable(L, idx)) {
+			lua_getfield(L, idx, "class");
+			is_list = lua_isnil(L, -1);
+			lua_settop(L, top);
+		}
 
-		int n = lua_gettop(L);
+		if (!is_list) {
+			lua_pushvalue(L, idx);
+			auto e = LuaToAssEntry(L, ass);
+			modification_type |= modification_mask(e.get());
+			InsertLine(vec, vec.size(), std::move(e));
+			lua_settop(L, top);
+			return;
+		}
 
-		for (int i = 1; i <= n; i++) {
-			lua_pushvalue(L, i);
+		size_t n = lua_objlen(L, idx);
+		vec.reserve(vec.size() + n);
+		for (size_t i = 1; i <= n; ++i) {
+			lua_rawgeti(L, idx, i);
 			auto e = LuaToAssEntry(L, ass);
 			modification_type |= modification_mask(e.get());
+			InsertLine(vec, vec.size(), std::move(e));
+			lua_settop(L, top);
+		}
+	}
 
-			if (lines.empty()) {
-				InsertLine(lines, 0, std::move(e));
-				continue;
+	void LuaAssFile::ObjectAppend(lua_State *L)
+	{
+		CheckAllowModify();
+
+		std::vector<AssEntry *> new_entries;
+		int n = lua_gettop(L);
+		for (int i = 1; i <= n; i++)
+			LuaToLines(L, i, new_entries);
+
+		// Insert all of the new lines of each group after the last existing
+		// line of that group in one go, rather than shifting everything
+		// after the insertion point once per line
+		auto group_of = [](AssEntry *e) { return e ? e->Group() : AssEntryGroup::INFO; };
+		std::vector<AssEntry *> group_entries;
+		for (size_t first = 0; first < new_entries.size(); ++first) {
+			if (!new_entries[first]) continue;
+
+			auto group = group_of(new_entries[first]);
+			group_entries.clear();
+			for (size_t i = first; i < new_entries.size(); ++i) {
+				if (new_entries[i] && group_of(new_entries[i]) == group) {
+					group_entries.push_back(new_entries[i]);
+					new_entries[i] = nullptr;
+				}
 			}
 
-			// Find the appropriate place to put it
-			auto group = e->Group();
+			// Find the appropriate place to put them; if no lines of this
+			// type exist already, just append them to the end
+			size_t pos = lines.size();
 			for (size_t i = lines.size(); i > 0; --i) {
-				auto cur_group = lines[i - 1] ? lines[i - 1]->Group() : AssEntryGroup::INFO;
-				if (cur_group == group) {
-					InsertLine(lines, i, std::move(e));
+				if (group_of(lines[i - 1]) == group) {
+					pos = i;
 					break;
 				}
 			}
-
-			// No lines of this type exist already, so just append it to the end
-			if (e) InsertLine(lines, lines.size(), std::move(e));
+			lines.insert(lines.begin() + pos, group_entries.begin(), group_entries.end());
 		}
 	}
 
@@ -583,16 +759,105 @@ namespace Automation4 {
 		int n = lua_gettop(L);
 		std::vector<AssEntry *> new_entries;
 		new_entries.reserve(n - 1);
-		for (int i = 2; i <= n; i++) {
-			lua_pushvalue(L, i);
-			auto e = LuaToAssEntry(L, ass);
-			modification_type |= modification_mask(e.get());
-			InsertLine(new_entries, i - 2, std::move(e));
-			lua_pop(L, 1);
-		}
+		for (int i = 2; i <= n; i++)
+			LuaToLines(L, i, new_entries);
 		lines.insert(lines.begin() + before - 1, new_entries.begin(), new_entries.end());
 	}
 
+	void LuaAssFile::ObjectReplaceRange(lua_State *L)
+	{
+		CheckAllowModify();
+
+		size_t a = std::max<size_t>(check_uint(L, 1), 1) - 1;
+		size_t b = std::min<size_t>(check_uint(L, 2), lines.size());
+		argcheck(L, a <= lines.size(), 1, "Out of range line index");
+		b = std::max(a, b);
+
+		std::vector<AssEntry *> new_entries;
+		int n = lua_gettop(L);
+		for (int i = 3; i <= n; i++)
+			LuaToLines(L, i, new_entries);
+
+		for (size_t i = a; i < b; ++i) {
+			modification_type |= modification_mask(lines[i]);
+			QueueLineForDeletion(i);
+		}
+
+		// Overwrite the replaced lines in place and only shift the rest of
+		// the file if the number of lines changed
+		size_t common = std::min(b - a, new_entries.size());
+		std::copy(new_entries.begin(), new_entries.begin() + common, lines.begin() + a);
+		if (common < b - a)
+			lines.erase(lines.begin() + a + common, lines.begin() + b);
+		else
+			lines.insert(lines.begin() + b, new_entries.begin() + common, new_entries.end());
+	}
+
+	void LuaAssFile::ObjectApply(lua_State *L)
+	{
+		CheckAllowModify();
+		luaL_checktype(L, 1, LUA_TFUNCTION);
+		lua_settop(L, 1);
+
+		// Deleting or replacing a header line makes copies of all of them,
+		// which would leave the lines already processed out of date
+		InitScriptInfoIfNeeded();
+
+		struct applying_guard {
+			bool &applying;
+			applying_guard(bool &applying) : applying(applying) { applying = true; }
+			~applying_guard() { applying = false; }
+		} guard(applying);
+
+		// Nothing is queued for deletion or swapped in until every line has
+		// been processed, as the callback can error and the script can catch
+		// it. The lines created by the callback aren't owned by anything
+		// until then, so free them if that happens.
+		struct new_lines_guard {
+			std::vector<AssEntry *> const& lines;
+			std::vector<AssEntry *> new_lines;
+			bool committed = false;
+			new_lines_guard(std::vector<AssEntry *> const& lines) : lines(lines) { }
+			~new_lines_guard() {
+				if (committed) return;
+				std::unordered_set<AssEntry *> old_lines(lines.begin(), lines.end());
+				for (auto e : new_lines) {
+					// Script info lines are already owned by lines_to_delete
+					if (e && !old_lines.count(e) && e->Group() != AssEntryGroup::INFO)
+						delete e;
+				}
+			}
+		} pending(lines);
+		auto& new_lines = pending.new_lines;
+		new_lines.reserve(lines.size());
+
+		std::vector<size_t> removed;
+		for (size_t i = 0; i < lines.size(); ++i) {
+			lua_pushvalue(L, 1);
+			LazyEntryToLua(L, i);
+			push_value(L, i + 1);
+			lua_call(L, 2, 1);
+
+			// Returning nothing keeps the line, false deletes it, and a line
+			// or list of lines replaces it
+			if (lua_isnil(L, -1)) {
+				new_lines.push_back(lines[i]);
+			}
+			else {
+				if (!lua_isboolean(L, -1) || lua_toboolean(L, -1))
+					LuaToLines(L, 2, new_lines);
+				modification_type |= modification_mask(lines[i]);
+				removed.push_back(i);
+			}
+			lua_settop(L, 1);
+		}
+
+		for (size_t i : removed)
+			QueueLineForDeletion(i);
+		lines = std::move(new_lines);
+		pending.committed = true;
+	}
+
 	void LuaAssFile::ObjectGarbageCollect(lua_State *L)
 	{
 		references--;
@@ -622,6 +887,36 @@ namespace Automation4 {
 		return 2;
 	}
 
+	int LuaAssFile::ObjectLazy(lua_State *L)
+	{
+		int idx = check_int(L, 1);
+		CheckBounds(idx);
+		LazyEntryToLua(L, idx - 1);
+		return 1;
+	}
+
+	int LuaAssFile::ObjectLazyIPairs(lua_State *L)
+	{
+		lua_pushvalue(L, lua_upvalueindex(1)); // push 'this' as userdata
+		lua_pushcclosure(L, closure_wrapper<&LuaAssFile::LazyIterNext>, 1);
+		lua_pushnil(L);
+		push_value(L, 0);
+		return 3;
+	}
+
+	int LuaAssFile::LazyIterNext(lua_State *L)
+	{
+		size_t i = check_uint(L, 2);
+		if (i >= lines.size()) {
+			lua_pushnil(L);
+			return 1;
+		}
+
+		push_value(L, i + 1);
+		LazyEntryToLua(L, i);
+		return 2;
+	}
+
 	int LuaAssFile::LuaParseKaraokeData(lua_State *L)
 	{
 		auto e = LuaToAssEntry(L, ass);
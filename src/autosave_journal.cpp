@@ -0,0 +1,347 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "autosave_journal.h"
+
+#include "ass_attachment.h"
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "ass_info.h"
+#include "ass_parser.h"
+#include "ass_style.h"
+#include "subtitle_format.h"
+#include "subtitle_format_ass.h"
+
+#include <libaegisub/exception.h>
+#include <libaegisub/format.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/io.h>
+#include <libaegisub/line_iterator.h>
+#include <libaegisub/util.h>
+#include <libaegisub/vfr.h>
+
+#include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <sstream>
+#include <unordered_map>
+
+DEFINE_EXCEPTION(AutosaveJournalError, agi::InvalidInputException);
+
+namespace {
+/// Start a new checkpoint after this many journal entries, as recovering
+/// from the end of a long journal means replaying all of it
+const size_t max_journal_entries = 100;
+
+const char entry_start[] = "[Autosave Journal Entry]";
+const char entry_events[] = "[Journal Events]";
+const char entry_end[] = "[Autosave Journal Entry End]";
+
+/// A complete entry read from a journal
+struct JournalEntry {
+	std::string time;
+	/// The metadata sections in ASS format, or empty if they didn't change
+	std::vector<std::string> metadata;
+	/// Keep lines and new dialogue lines, in file order
+	std::vector<std::string> events;
+};
+
+bool same_properties(ProjectProperties const& a, ProjectProperties const& b) {
+	return a.automation_scripts == b.automation_scripts
+		&& a.export_filters == b.export_filters
+		&& a.export_encoding == b.export_encoding
+		&& a.style_storage == b.style_storage
+		&& a.audio_file == b.audio_file
+		&& a.video_file == b.video_file
+		&& a.timecodes_file == b.timecodes_file
+		&& a.keyframes_file == b.keyframes_file
+		&& a.automation_settings == b.automation_settings
+		&& a.video_zoom == b.video_zoom
+		&& a.ar_value == b.ar_value
+		&& a.scroll_position == b.scroll_position
+		&& a.active_row == b.active_row
+		&& a.ar_mode == b.ar_mode
+		&& a.video_position == b.video_position;
+}
+
+/// Build a file holding everything in a snapshot but the dialogue lines
+void fill_metadata(AssFile& file, AutosaveSnapshot const& snapshot) {
+	for (auto const& info : *snapshot.script_info)
+		file.Info.emplace_back(info.first, info.second);
+	for (auto const& style : *snapshot.styles)
+		file.Styles.push_back(*new AssStyle(style));
+	file.Extradata = *snapshot.extradata;
+	file.Properties = *snapshot.properties;
+	for (auto const& entry : file.Extradata)
+		file.next_extradata_id = std::max(file.next_extradata_id, entry.id + 1);
+}
+
+/// Call on_entry for each complete entry in a journal
+///
+/// An entry which was cut off by a crash while it was being written is
+/// skipped, as is anything else outside of an entry.
+template<typename Func>
+void read_journal(agi::fs::path const& path, Func&& on_entry) {
+	enum { OUTSIDE, HEADER, METADATA, EVENTS } state = OUTSIDE;
+	JournalEntry entry;
+
+	auto in = agi::io::Open(path, true);
+	for (auto const& line : agi::line_iterator<std::string>(*in)) {
+		if (line == entry_start) {
+			entry = JournalEntry();
+			state = HEADER;
+			continue;
+		}
+
+		switch (state) {
+			case OUTSIDE:
+				break;
+			case HEADER:
+				if (boost::starts_with(line, "Time: "))
+					entry.time = line.substr(6);
+				else if (line == "[Script Info]") {
+					entry.metadata.push_back(line);
+					state = METADATA;
+				}
+				else if (line == entry_events)
+					state = EVENTS;
+				break;
+			case METADATA:
+				if (line == entry_events)
+					state = EVENTS;
+				else
+					entry.metadata.push_back(line);
+				break;
+			case EVENTS:
+				if (line == entry_end) {
+					on_entry(std::move(entry));
+					state = OUTSIDE;
+				}
+				else if (!line.empty())
+					entry.events.push_back(line);
+				break;
+		}
+	}
+}
+
+/// Apply one journal entry to the file it was written against
+void apply_entry(AssFile& file, JournalEntry const& entry) {
+	if (!entry.metadata.empty()) {
+		AssFile metadata;
+		AssParser parser(&metadata, 1);
+		for (auto const& line : entry.metadata)
+			parser.AddLine(line);
+
+		file.Info = std::move(metadata.Info);
+		file.Styles.swap(metadata.Styles);
+		file.Extradata = std::move(metadata.Extradata);
+		file.Properties = metadata.Properties;
+		file.next_extradata_id = std::max(file.next_extradata_id, metadata.next_extradata_id);
+	}
+
+	std::vector<AssDialogue *> rows;
+	for (auto& line : file.Events)
+		rows.push_back(&line);
+
+	// Lines which aren't kept are deleted along with old
+	AssFile old;
+	old.Events.swap(file.Events);
+
+	for (auto const& line : entry.events) {
+		if (boost::starts_with(line, "Keep: ")) {
+			size_t start = 0, count = 0;
+			char sep = 0;
+			std::istringstream ss(line.substr(6));
+			if (!(ss >> start >> sep >> count) || sep != ',' || start > rows.size() || count > rows.size() - start)
+				throw AutosaveJournalError("Invalid line in autosave journal: " + line);
+
+			for (size_t i = start; i < start + count; ++i) {
+				auto row = rows[i];
+				if (!row)
+					throw AutosaveJournalError("Invalid line in autosave journal: " + line);
+				rows[i] = nullptr;
+				old.Events.erase(old.Events.iterator_to(*row));
+				file.Events.push_back(*row);
+			}
+		}
+		else if (boost::starts_with(line, "Dialogue:") || boost::starts_with(line, "Comment:"))
+			file.Events.push_back(*new AssDialogue(line));
+		else
+			throw AutosaveJournalError("Invalid line in autosave journal: " + line);
+	}
+}
+}
+
+agi::fs::path AutosaveJournal::JournalPath(agi::fs::path const& checkpoint) {
+	auto path = checkpoint;
+	path += ".journal";
+	return path;
+}
+
+void AutosaveJournal::WriteCheckpoint(AutosaveSnapshot const& snapshot, agi::fs::path const& path) {
+	AssFile file;
+	fill_metadata(file, snapshot);
+	file.Attachments = *snapshot.attachments;
+	for (auto const& chunk : snapshot.events) {
+		for (auto const& line : *chunk)
+			file.Events.push_back(*new AssDialogue(*line));
+	}
+
+	// A journal left over from an earlier checkpoint written to the same
+	// path in the same second no longer applies
+	auto journal = JournalPath(path);
+	if (agi::fs::FileExists(journal))
+		agi::fs::Remove(journal);
+
+	AssSubtitleFormat().WriteFile(&file, path, 0, "utf-8");
+}
+
+std::string AutosaveJournal::EntryFor(AutosaveSnapshot const& snapshot, std::string const& time) const {
+	std::ostringstream out;
+	out << entry_start << "\nTime: " << time << '\n';
+
+	if (snapshot.script_info != last.script_info || snapshot.styles != last.styles
+		|| snapshot.extradata != last.extradata || !same_properties(*snapshot.properties, *last.properties)) {
+		AssFile metadata;
+		fill_metadata(metadata, snapshot);
+		AssSubtitleFormat::WriteMetadata(&metadata, out);
+	}
+
+	out << entry_events << '\n';
+
+	// Unchanged lines are the same objects as in the previous snapshot, so
+	// lines can be matched up by address without comparing their contents
+	std::unordered_map<const AssDialogueBase *, size_t> prev_rows;
+	size_t row = 0;
+	for (auto const& chunk : last.events) {
+		for (auto const& line : *chunk)
+			prev_rows.emplace(line.get(), row++);
+	}
+
+	size_t keep_start = 0, keep_count = 0;
+	auto flush_keep = [&] {
+		if (keep_count)
+			out << "Keep: " << keep_start << ',' << keep_count << '\n';
+		keep_count = 0;
+	};
+
+	for (auto const& chunk : snapshot.events) {
+		for (auto const& line : *chunk) {
+			auto it = prev_rows.find(line.get());
+			if (it == prev_rows.end()) {
+				flush_keep();
+				out << AssDialogue(*line).GetEntryData() << '\n';
+				continue;
+			}
+
+			if (!keep_count || keep_start + keep_count != it->second) {
+				flush_keep();
+				keep_start = it->second;
+			}
+			++keep_count;
+			// Each old line can only be kept once
+			prev_rows.erase(it);
+		}
+	}
+	flush_keep();
+
+	out << entry_end << '\n';
+	return out.str();
+}
+
+agi::fs::path AutosaveJournal::Save(AutosaveSnapshot snapshot, agi::fs::path const& directory, agi::fs::path const& name) {
+	auto time = agi::util::strftime("%Y-%m-%d-%H-%M-%S");
+
+	// Attachments are large and rarely change, so they're only ever written
+	// in checkpoints
+	if (!checkpoint.empty() && directory == this->directory && name == this->name
+		&& snapshot.attachments == last.attachments && entries < max_journal_entries) {
+		auto entry = EntryFor(snapshot, time);
+		if (journal_size + entry.size() <= checkpoint_size / 2) {
+			auto journal = JournalPath(checkpoint);
+			boost::filesystem::ofstream out(journal, std::ios::out | std::ios::app | std::ios::binary);
+			out.write(entry.data(), entry.size());
+			out.flush();
+			if (!out.good()) {
+				// The journal may now end with a partial entry, which is
+				// harmless, but it's no longer safe to keep appending to it
+				checkpoint.clear();
+				throw agi::fs::WriteDenied(journal);
+			}
+
+			journal_size += entry.size();
+			++entries;
+			last = std::move(snapshot);
+			return journal;
+		}
+	}
+
+	agi::fs::CreateDirectory(directory);
+	auto path = directory / agi::format("%s.%s.AUTOSAVE.ass", name.string(), time);
+	checkpoint.clear();
+	WriteCheckpoint(snapshot, path);
+
+	checkpoint = path;
+	this->directory = directory;
+	this->name = name;
+	entries = 0;
+	checkpoint_size = agi::fs::Size(path);
+	journal_size = 0;
+	last = std::move(snapshot);
+	return path;
+}
+
+std::vector<std::string> AutosaveJournal::ListEntries(agi::fs::path const& journal) {
+	std::vector<std::string> times;
+	if (agi::fs::FileExists(journal))
+		read_journal(journal, [&](JournalEntry&& entry) { times.push_back(std::move(entry.time)); });
+	return times;
+}
+
+agi::fs::path AutosaveJournal::Recover(agi::fs::path const& checkpoint, size_t entries, agi::fs::path const& directory) {
+	// Checkpoints are named name.date.AUTOSAVE.ass, and the recovered file
+	// is named name.date.ass after the time of the last entry replayed
+	auto name = checkpoint.filename().string();
+	if (boost::ends_with(name, ".AUTOSAVE.ass"))
+		name.resize(name.size() - 13);
+	std::string time;
+	auto date_start = name.rfind('.');
+	if (date_start != std::string::npos) {
+		time = name.substr(date_start + 1);
+		name.resize(date_start);
+	}
+	name = agi::fs::path(name).stem().string();
+
+	AssFile file;
+	AssSubtitleFormat().ReadFile(&file, checkpoint, 0, "utf-8");
+
+	size_t applied = 0;
+	if (entries) {
+		read_journal(JournalPath(checkpoint), [&](JournalEntry&& entry) {
+			if (applied == entries) return;
+			apply_entry(file, entry);
+			time = std::move(entry.time);
+			++applied;
+		});
+	}
+	if (applied != entries)
+		throw AutosaveJournalError("Autosave journal is missing entries: " + JournalPath(checkpoint).string());
+
+	agi::fs::CreateDirectory(directory);
+	auto path = directory / agi::format("%s.%s.ass", name, time);
+	SubtitleFormat::GetWriter(path)->WriteFile(&file, path, 0);
+	return path;
+}
@@ -0,0 +1,100 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/fs_fwd.h>
+
+#include <boost/filesystem/path.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class AssAttachment;
+class AssStyle;
+struct AssDialogueBase;
+struct ExtradataEntry;
+struct ProjectProperties;
+
+/// A run of dialogue lines which is shared between versions of a file
+typedef std::vector<std::shared_ptr<const AssDialogueBase>> EventChunk;
+
+/// An immutable copy of the state of a file
+///
+/// Everything is shared with the undo stack, so taking one costs a few
+/// reference count increments, and a section or line which hasn't changed
+/// between two snapshots is the same object in both.
+struct AutosaveSnapshot {
+	std::shared_ptr<const std::vector<std::pair<std::string, std::string>>> script_info;
+	std::shared_ptr<const std::vector<AssStyle>> styles;
+	std::vector<std::shared_ptr<const EventChunk>> events;
+	std::shared_ptr<const std::vector<AssAttachment>> attachments;
+	std::shared_ptr<const std::vector<ExtradataEntry>> extradata;
+	std::shared_ptr<const ProjectProperties> properties;
+};
+
+/// @class AutosaveJournal
+/// @brief Incremental autosaves of a single file
+///
+/// The first autosave of a file writes a full checkpoint in the same format
+/// as the autosaves have always been written in. Each later one appends an
+/// entry to a journal next to the checkpoint holding only what changed since
+/// the previous autosave: the new and edited lines, with runs of unchanged
+/// lines referred to by index, and the styles, script info, extradata and
+/// project properties if any of them changed. Once the journal has grown
+/// large relative to the checkpoint a new checkpoint is written and the
+/// journal starts over.
+///
+/// Not thread-safe; all calls to Save on an object must be made from the
+/// same thread.
+class AutosaveJournal {
+	/// The state the checkpoint and journal currently describe
+	AutosaveSnapshot last;
+	/// Checkpoint which the journal applies to
+	agi::fs::path checkpoint;
+	/// Directory and name that the checkpoint was written for
+	agi::fs::path directory, name;
+	/// Number of entries in the journal
+	size_t entries = 0;
+	uintmax_t checkpoint_size = 0;
+	uintmax_t journal_size = 0;
+
+	void WriteCheckpoint(AutosaveSnapshot const& snapshot, agi::fs::path const& path);
+	std::string EntryFor(AutosaveSnapshot const& snapshot, std::string const& time) const;
+
+public:
+	/// Autosave a file
+	/// @param snapshot Current state of the file
+	/// @param directory Autosave directory
+	/// @param name Filename of the file being saved
+	/// @return Path to the checkpoint or journal which was written to
+	agi::fs::path Save(AutosaveSnapshot snapshot, agi::fs::path const& directory, agi::fs::path const& name);
+
+	/// Get the path of the journal for a checkpoint
+	static agi::fs::path JournalPath(agi::fs::path const& checkpoint);
+
+	/// Get the time each complete entry in a journal was written at
+	/// @param journal Journal to read, which need not exist
+	/// @return Times in the "%Y-%m-%d-%H-%M-%S" format used for autosave filenames
+	static std::vector<std::string> ListEntries(agi::fs::path const& journal);
+
+	/// Reconstruct the file as of a journal entry
+	/// @param checkpoint Checkpoint the journal applies to
+	/// @param entries Number of journal entries to replay
+	/// @param directory Directory to write the recovered file to
+	/// @return Path to the recovered file
+	static agi::fs::path Recover(agi::fs::path const& checkpoint, size_t entries, agi::fs::path const& directory);
+};
@@ -128,12 +128,15 @@ BEGIN_EVENT_TABLE(BaseGrid,wxWindow)
 	EVT_IDLE(BaseGrid::OnIdle)
 END_EVENT_TABLE()
 
-void BaseGrid::OnSubtitlesCommit(int type) {
-	if (type == AssFile::COMMIT_NEW || type & AssFile::COMMIT_ORDER || type & AssFile::COMMIT_DIAG_ADDREM)
+void BaseGrid::OnSubtitlesCommit(int type, const AssDialogue *single_line) {
+	bool remapped = type == AssFile::COMMIT_NEW || type & AssFile::COMMIT_ORDER || type & AssFile::COMMIT_DIAG_ADDREM;
+	if (remapped)
 		UpdateMaps();
 
 	if (type & AssFile::COMMIT_DIAG_META) {
-		SetColumnWidths();
+		// UpdateMaps has already recalculated all of the widths
+		if (!remapped)
+			SetColumnWidths(single_line);
 		Refresh(false);
 		return;
 	}
@@ -527,12 +530,7 @@ void BaseGrid::OnMouseEvent(wxMouseEvent &event) {
 			if (i1 > i2)
 				std::swap(i1, i2);
 
-			// Toggle each
-			Selection newsel;
-			if (ctrl) newsel = selection;
-			for (int i = i1; i <= i2; i++)
-				newsel.insert(GetDialogue(i));
-			context->selectionController->SetSelectedSet(std::move(newsel));
+			context->selectionController->SelectRange(i1, i2, ctrl);
 			return;
 		}
 
@@ -602,7 +600,7 @@ void BaseGrid::AdjustScrollbar() {
 	scrollBar->Thaw();
 }
 
-void BaseGrid::SetColumnWidths() {
+void BaseGrid::SetColumnWidths(const AssDialogue *changed) {
 	int w, h;
 	GetClientSize(&w, &h);
 
@@ -618,12 +616,18 @@ void BaseGrid::SetColumnWidths() {
 	width_helper->SetDC(&dc);
 
 	for (auto const& column : columns) {
-		column->UpdateWidth(context, *width_helper);
+		if (changed)
+			column->UpdateWidthForLine(context, *width_helper, changed);
+		else
+			column->UpdateWidth(context, *width_helper);
 		if (column->Width() && column->RefreshOnTextChange())
 			text_refresh_rects.emplace_back(x, 0, column->Width(), h);
 		x += column->Width();
 	}
-	width_helper->Age();
+
+	// Only a full update touches every value which is still in use
+	if (!changed)
+		width_helper->Age();
 }
 
 AssDialogue *BaseGrid::GetDialogue(int n) const {
@@ -715,11 +719,7 @@ void BaseGrid::OnKeyDown(wxKeyEvent &event) {
 			std::swap(begin, end);
 
 		// Select range
-		Selection newsel;
-		for (int i = begin; i <= end; i++)
-			newsel.insert(GetDialogue(i));
-
-		context->selectionController->SetSelectedSet(std::move(newsel));
+		context->selectionController->SelectRange(begin, end);
 
 		MakeRowVisible(next);
 		return;
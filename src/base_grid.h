@@ -103,12 +103,13 @@ class BaseGrid final : public wxWindow {
 	void OnScroll(wxScrollEvent &event);
 	void OnShowColMenu(wxCommandEvent &event);
 	void OnSize(wxSizeEvent &event);
-	void OnSubtitlesCommit(int type);
+	void OnSubtitlesCommit(int type, const AssDialogue *single_line);
 	void OnActiveLineChanged(AssDialogue *);
 	void OnSeek();
 
 	void AdjustScrollbar();
-	void SetColumnWidths();
+	/// Recalculate the column widths, or update them for one changed line
+	void SetColumnWidths(const AssDialogue *changed = nullptr);
 
 	bool IsDisplayed(const AssDialogue *line) const;
 
@@ -157,6 +157,24 @@ public:
 		}
 	}
 
+	/// @brief Call a function for every block currently in the cache
+	/// @param func Function taking the index of a block and the block
+	///
+	/// Does not affect the age of the blocks visited.
+	template<typename Func>
+	void ForEach(Func const& func) const
+	{
+		for (size_t mbi = 0; mbi < data.size(); ++mbi)
+		{
+			auto const& blocks = data[mbi].blocks;
+			for (size_t bi = 0; bi < blocks.size(); ++bi)
+			{
+				if (blocks[bi])
+					func((mbi << MacroblockExponent) + bi, *blocks[bi]);
+			}
+		}
+	}
+
 	/// @brief Obtain a data block from the cache
 	/// @param      i       Index of the block to retrieve
 	/// @param[out] created On return, tells whether the returned block was created during the operation
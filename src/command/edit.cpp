@@ -1022,16 +1022,22 @@ struct edit_line_recombine final : public validate_sel_multiple {
 				++d2;
 		}
 
-		// Remove now non-existent lines from the selection
-		Selection lines, new_sel;
-		boost::copy(c->ass->Events | agi::address_of, inserter(lines, lines.begin()));
-		boost::set_intersection(lines, sel_set, inserter(new_sel, new_sel.begin()));
+		// Remove now non-existent lines from the selection, noting whether
+		// the active line survived as it may have been deleted
+		Selection new_sel;
+		bool active_line_kept = false;
+		for (auto& line : c->ass->Events) {
+			if (sel_set.count(&line)) {
+				new_sel.insert(&line);
+				active_line_kept = active_line_kept || &line == active_line;
+			}
+		}
 
 		if (new_sel.empty())
-			new_sel.insert(*lines.begin());
+			new_sel.insert(&c->ass->Events.front());
 
 		// Restore selection
-		if (!new_sel.count(active_line))
+		if (!active_line_kept)
 			active_line = *new_sel.begin();
 		c->selectionController->SetSelectionAndActive(std::move(new_sel), active_line);
 
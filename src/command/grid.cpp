@@ -392,7 +392,7 @@ struct grid_swap final : public Command {
 	void operator()(agi::Context *c) override {
 		auto const& sel = c->selectionController->GetSelectedSet();
 		if (sel.size() == 2) {
-			(*sel.begin())->swap_nodes(**sel.rbegin());
+			(*sel.begin())->swap_nodes(**std::next(sel.begin()));
 			c->ass->Commit(_("swap lines"), AssFile::COMMIT_ORDER);
 		}
 	}
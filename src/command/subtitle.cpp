@@ -49,11 +49,9 @@
 #include "../utils.h"
 #include "../video_controller.h"
 
-#include <libaegisub/address_of_adaptor.h>
 #include <libaegisub/charset_conv.h>
 #include <libaegisub/make_unique.h>
 
-#include <boost/range/algorithm/copy.hpp>
 #include <wx/msgdlg.h>
 #include <wx/choicdlg.h>
 
@@ -398,9 +396,18 @@ struct subtitle_select_all final : public Command {
 	STR_HELP("Select all dialogue lines")
 
 	void operator()(agi::Context *c) override {
-		Selection sel;
-		boost::copy(c->ass->Events | agi::address_of, inserter(sel, sel.end()));
-		c->selectionController->SetSelectedSet(std::move(sel));
+		c->selectionController->SelectAll();
+	}
+};
+
+struct subtitle_select_invert final : public Command {
+	CMD_NAME("subtitle/select/invert")
+	STR_MENU("&Invert Selection")
+	STR_DISP("Invert Selection")
+	STR_HELP("Select all dialogue lines which aren't selected and deselect the ones which are")
+
+	void operator()(agi::Context *c) override {
+		c->selectionController->InvertSelection();
 	}
 };
 
@@ -469,6 +476,7 @@ namespace cmd {
 		reg(agi::make_unique<subtitle_save>());
 		reg(agi::make_unique<subtitle_save_as>());
 		reg(agi::make_unique<subtitle_select_all>());
+		reg(agi::make_unique<subtitle_select_invert>());
 		reg(agi::make_unique<subtitle_select_visible>());
 		reg(agi::make_unique<subtitle_spellcheck>());
 	}
@@ -14,11 +14,13 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#include "autosave_journal.h"
 #include "compat.h"
 #include "format.h"
 #include "libresrc/libresrc.h"
 #include "options.h"
 
+#include <libaegisub/exception.h>
 #include <libaegisub/path.h>
 
 #include <boost/range/adaptor/map.hpp>
@@ -30,6 +32,7 @@
 #include <wx/dir.h>
 #include <wx/filename.h>
 #include <wx/listbox.h>
+#include <wx/msgdlg.h>
 #include <wx/sizer.h>
 #include <wx/string.h>
 
@@ -38,6 +41,8 @@ struct Version {
 	wxString filename;
 	wxDateTime date;
 	wxString display;
+	/// Number of entries from the checkpoint's journal to replay, if any
+	size_t journal_entries = 0;
 };
 
 struct AutosaveFile {
@@ -144,7 +149,31 @@ void DialogAutosave::Populate(std::map<wxString, AutosaveFile> &files_map, std::
 		auto it = files_map.find(name);
 		if (it == files_map.end())
 			it = files_map.insert({name, AutosaveFile{name, std::vector<Version>()}}).first;
-		it->second.versions.push_back(Version{wxFileName(directory, fn).GetFullPath(), date, agi::wxformat(name_fmt, date.Format())});
+
+		Version version;
+		version.filename = wxFileName(directory, fn).GetFullPath();
+		version.date = date;
+		version.display = agi::wxformat(name_fmt, date.Format());
+		it->second.versions.push_back(version);
+
+		// Each autosave after the first since the file was opened is an
+		// entry in the checkpoint's journal rather than a separate file
+		std::vector<std::string> entries;
+		try {
+			entries = AutosaveJournal::ListEntries(AutosaveJournal::JournalPath(from_wx(version.filename)));
+		}
+		catch (agi::Exception const&) {
+			// An unreadable journal still leaves the checkpoint usable
+		}
+		for (size_t i = 0; i < entries.size(); ++i) {
+			wxDateTime entry_date;
+			if (!entry_date.ParseFormat(to_wx(entries[i]), "%Y-%m-%d-%H-%M-%S"))
+				entry_date = date;
+			version.date = entry_date;
+			version.display = agi::wxformat(name_fmt, entry_date.Format());
+			version.journal_entries = i + 1;
+			it->second.versions.push_back(version);
+		}
 	} while (dir.GetNext(&fn));
 }
 
@@ -165,7 +194,18 @@ std::string DialogAutosave::ChosenFile() const {
 	int sel_version = version_list->GetSelection();
 	if (sel_version < 0) return "";
 
-	return from_wx(files[sel_file].versions[sel_version].filename);
+	auto const& version = files[sel_file].versions[sel_version];
+	if (!version.journal_entries)
+		return from_wx(version.filename);
+
+	try {
+		return AutosaveJournal::Recover(from_wx(version.filename), version.journal_entries,
+			config::path->Decode("?user/recovered")).string();
+	}
+	catch (agi::Exception const& e) {
+		wxMessageBox(to_wx(e.GetMessage()), _("Error recovering autosave"), wxOK | wxICON_ERROR | wxCENTER, d.GetParent());
+		return "";
+	}
 }
 }
 
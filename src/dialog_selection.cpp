@@ -27,8 +27,6 @@
 #include "search_replace_engine.h"
 #include "selection_controller.h"
 
-#include <boost/range/algorithm/set_algorithm.hpp>
-
 #include <wx/checkbox.h>
 #include <wx/combobox.h>
 #include <wx/dialog.h>
@@ -75,7 +73,7 @@ enum Mode {
 	REGEXP
 };
 
-std::set<AssDialogue*> process(std::string const& match_text, bool match_case, Mode mode, bool invert, bool comments, bool dialogue, int field_n, AssFile *ass) {
+Selection process(std::string const& match_text, bool match_case, Mode mode, bool invert, bool comments, bool dialogue, int field_n, AssFile *ass) {
 	SearchReplaceSettings settings = {
 		match_text,
 		std::string(),
@@ -90,7 +88,7 @@ std::set<AssDialogue*> process(std::string const& match_text, bool match_case, M
 
 	auto predicate = SearchReplaceEngine::GetMatcher(settings);
 
-	std::set<AssDialogue*> matches;
+	Selection matches;
 	for (auto& diag : ass->Events) {
 		if (diag.Comment && !comments) continue;
 		if (!diag.Comment && !dialogue) continue;
@@ -183,7 +181,7 @@ DialogSelection::~DialogSelection() {
 }
 
 void DialogSelection::Process(wxCommandEvent& event) {
-	std::set<AssDialogue*> matches;
+	Selection matches;
 
 	try {
 		matches = process(
@@ -214,18 +212,24 @@ void DialogSelection::Process(wxCommandEvent& event) {
 			break;
 
 		case Action::ADD:
-			boost::set_union(old_sel, matches, inserter(new_sel, new_sel.begin()));
+			new_sel = old_sel;
+			new_sel.insert(matches.begin(), matches.end());
 			message = (count = new_sel.size() - old_sel.size())
 				? fmt_plural(count, "One line was added to selection", "%u lines were added to selection", count)
 				: _("No lines were added to selection");
 			break;
 
 		case Action::SUB:
-			boost::set_difference(old_sel, matches, inserter(new_sel, new_sel.begin()));
+			new_sel = old_sel;
+			for (auto line : matches)
+				new_sel.erase(line);
 			goto sub_message;
 
 		case Action::INTERSECT:
-			boost::set_intersection(old_sel, matches, inserter(new_sel, new_sel.begin()));
+			for (auto line : old_sel) {
+				if (matches.count(line))
+					new_sel.insert(line);
+			}
 			sub_message:
 			message = (count = old_sel.size() - new_sel.size())
 				? fmt_plural(count, "One line was removed from selection", "%u lines were removed from selection", count)
@@ -48,6 +48,7 @@
 #include <boost/range/algorithm.hpp>
 #include <boost/range/algorithm_ext/push_back.hpp>
 #include <functional>
+#include <set>
 #include <vector>
 #include <wx/button.h>
 #include <wx/checkbox.h>
@@ -368,35 +369,43 @@ static int get_closest_kf(std::vector<int> const& kf, int frame) {
 	return (pos == begin(kf) || *pos - frame < frame - *(pos - 1)) ? *pos : *(pos - 1);
 }
 
-template<class Iter, class Field>
-static int safe_time(Iter begin, Iter end, AssDialogue *comp, int initial, Field field, int const& (*cmp)(int const&, int const&)) {
-	// Compare to every previous line (yay for O(n^2)!) to see if it's OK to add lead-in
-	for (; begin != end; ++begin) {
-		// If the line doesn't already collide with this line, extend it only
-		// to the edge of the line
-		if (!comp->CollidesWith(*begin))
-			initial = cmp(initial, (*begin)->*field);
-	}
-	return initial;
-}
-
 void DialogTimingProcessor::Process() {
 	std::vector<AssDialogue*> sorted = SortDialogues();
 	if (sorted.empty()) return;
 
 	// Add lead-in/out
 	if (hasLeadIn->IsChecked() && leadIn) {
-		for (size_t i = 0; i < sorted.size(); ++i)
-			sorted[i]->Start = safe_time(sorted.rend() - i, sorted.rend(),
-				sorted[i], sorted[i]->Start - leadIn,
-				&AssDialogue::End, &std::max<int>);
+		// Lead-in can extend a line back as far as the end of the latest
+		// earlier line which it doesn't already overlap
+		std::multiset<int> ends;
+		for (auto line : sorted) {
+			int start = line->Start;
+			int new_start = start - leadIn;
+			auto prev = ends.upper_bound(start);
+			if (prev != ends.begin())
+				new_start = std::max(new_start, *--prev);
+			ends.insert(line->End);
+			line->Start = new_start;
+		}
 	}
 
 	if (hasLeadOut->IsChecked() && leadOut) {
-		for (size_t i = 0; i < sorted.size(); ++i)
-			sorted[i]->End = safe_time(sorted.begin() + i + 1, sorted.end(),
-				sorted[i], sorted[i]->End + leadOut,
-				&AssDialogue::Start, &std::min<int>);
+		// Lead-out can extend a line up to the start of the first later line
+		// which it doesn't already overlap. Lead-in never reorders the
+		// lines, so the start times are still sorted.
+		std::vector<int> starts;
+		starts.reserve(sorted.size());
+		for (auto line : sorted)
+			starts.push_back(line->Start);
+
+		for (size_t i = 0; i < sorted.size(); ++i) {
+			int end = sorted[i]->End;
+			int new_end = end + leadOut;
+			auto next = std::lower_bound(starts.begin() + i + 1, starts.end(), std::max(end, starts[i] + 1));
+			if (next != starts.end())
+				new_end = std::min(new_end, *next);
+			sorted[i]->End = new_end;
+		}
 	}
 
 	// Make adjacent
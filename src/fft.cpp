@@ -31,8 +31,8 @@
 /// @brief Fast Fourier-transform implementation
 /// @ingroup utility
 ///
-/// Most of this code was taken from http://www.codeproject.com/audio/waveInFFT.asp
-/// And rewriten by Rodrigo Braz Monteiro
+/// Real-input transform done as a half-length complex radix-2 transform
+/// followed by a split step, using precomputed tables for each size.
 
 #include "fft.h"
 
@@ -40,81 +40,206 @@
 #include <libaegisub/exception.h>
 
 #include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FFT_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FFT_NEON
+#endif
+
+namespace {
+/// Tables for transforming real input of a single power-of-two length
+struct FFTPlan {
+	/// Half of the input length; the size of the complex transform
+	size_t half;
+	/// Bit-reversed index of each complex input
+	std::vector<uint32_t> reverse;
+	/// Twiddle factors for the butterflies of each stage, stored contiguously
+	/// per stage with the stage of half-width h starting at index h - 1
+	std::vector<float> tw_r, tw_i;
+	/// exp(-2*pi*i*k/n) for k in [0, n/4], used to split the complex result
+	std::vector<float> split_r, split_i;
+
+	FFTPlan(size_t n, unsigned int bits);
+};
+
+FFTPlan::FFTPlan(size_t n, unsigned int bits)
+: half(n / 2)
+, reverse(half)
+, tw_r(half ? half - 1 : 0)
+, tw_i(half ? half - 1 : 0)
+, split_r(half / 2 + 1)
+, split_i(half / 2 + 1)
+{
+	const double pi = 3.1415926535897932384626433832795;
+
+	for (size_t i = 0; i < half; ++i) {
+		uint32_t rev = 0;
+		size_t index = i;
+		for (unsigned int b = 1; b < bits; ++b) {
+			rev = (rev << 1) | (index & 1);
+			index >>= 1;
+		}
+		reverse[i] = rev;
+	}
+
+	for (size_t h = 1; h < half; h <<= 1) {
+		for (size_t k = 0; k < h; ++k) {
+			tw_r[h - 1 + k] = (float)cos(-pi * k / h);
+			tw_i[h - 1 + k] = (float)sin(-pi * k / h);
+		}
+	}
+
+	for (size_t k = 0; k <= half / 2; ++k) {
+		split_r[k] = (float)cos(-2 * pi * k / n);
+		split_i[k] = (float)sin(-2 * pi * k / n);
+	}
+}
+
+/// Get the plan for a length of 2^bits, creating it the first time it's used
+FFTPlan const& GetPlan(size_t n, unsigned int bits) {
+	static std::mutex mutex;
+	static std::unique_ptr<FFTPlan> plans[sizeof(size_t) * 8];
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto& plan = plans[bits];
+	if (!plan)
+		plan.reset(new FFTPlan(n, bits));
+	return *plan;
+}
+
+/// One butterfly stage over split real/imaginary arrays
+void Butterflies(size_t n, size_t h, const float *wr, const float *wi, float *re, float *im) {
+	for (size_t i = 0; i < n; i += 2 * h) {
+		float *ar = re + i, *ai = im + i;
+		float *br = ar + h, *bi = ai + h;
+		size_t k = 0;
+
+#if defined(FFT_SSE2)
+		for (; k + 4 <= h; k += 4) {
+			__m128 w_r = _mm_loadu_ps(wr + k), w_i = _mm_loadu_ps(wi + k);
+			__m128 b_r = _mm_loadu_ps(br + k), b_i = _mm_loadu_ps(bi + k);
+			__m128 a_r = _mm_loadu_ps(ar + k), a_i = _mm_loadu_ps(ai + k);
+			__m128 t_r = _mm_sub_ps(_mm_mul_ps(w_r, b_r), _mm_mul_ps(w_i, b_i));
+			__m128 t_i = _mm_add_ps(_mm_mul_ps(w_r, b_i), _mm_mul_ps(w_i, b_r));
+			_mm_storeu_ps(br + k, _mm_sub_ps(a_r, t_r));
+			_mm_storeu_ps(bi + k, _mm_sub_ps(a_i, t_i));
+			_mm_storeu_ps(ar + k, _mm_add_ps(a_r, t_r));
+			_mm_storeu_ps(ai + k, _mm_add_ps(a_i, t_i));
+		}
+#elif defined(FFT_NEON)
+		for (; k + 4 <= h; k += 4) {
+			float32x4_t w_r = vld1q_f32(wr + k), w_i = vld1q_f32(wi + k);
+			float32x4_t b_r = vld1q_f32(br + k), b_i = vld1q_f32(bi + k);
+			float32x4_t a_r = vld1q_f32(ar + k), a_i = vld1q_f32(ai + k);
+			float32x4_t t_r = vmlsq_f32(vmulq_f32(w_r, b_r), w_i, b_i);
+			float32x4_t t_i = vmlaq_f32(vmulq_f32(w_r, b_i), w_i, b_r);
+			vst1q_f32(br + k, vsubq_f32(a_r, t_r));
+			vst1q_f32(bi + k, vsubq_f32(a_i, t_i));
+			vst1q_f32(ar + k, vaddq_f32(a_r, t_r));
+			vst1q_f32(ai + k, vaddq_f32(a_i, t_i));
+		}
+#endif
+
+		for (; k < h; ++k) {
+			float t_r = wr[k] * br[k] - wi[k] * bi[k];
+			float t_i = wr[k] * bi[k] + wi[k] * br[k];
+			br[k] = ar[k] - t_r;
+			bi[k] = ai[k] - t_i;
+			ar[k] += t_r;
+			ai[k] += t_i;
+		}
+	}
+}
+}
 
 void FFT::DoTransform (size_t n_samples,float *input,float *output_r,float *output_i,bool inverse) {
 	if (!IsPowerOfTwo(n_samples))
 		throw agi::InternalError("FFT requires power of two input.");
 
-	// Inverse transform
-	float angle_num = 2.0f * 3.1415926535897932384626433832795f;
-	if (inverse) angle_num = -angle_num;
+	FFTPlan const& plan = GetPlan(n_samples, NumberOfBitsNeeded(n_samples));
+	const size_t half = plan.half;
 
-	// Variables
-	unsigned int i, j, k, n;
-	float tr, ti;
-
-	// Calculate needed bits
-	unsigned int NumBits;
-	NumBits = NumberOfBitsNeeded(n_samples);
+	// Pack pairs of real samples into complex values in bit-reversed order
+	for (size_t i = 0; i < half; ++i) {
+		output_r[plan.reverse[i]] = input[2 * i];
+		output_i[plan.reverse[i]] = input[2 * i + 1];
+	}
 
-	// Copy samples to output buffers
-	for (i=0;i<n_samples;i++) {
-		j = ReverseBits (i,NumBits);
-		output_r[j] = input[i];
-		output_i[j] = 0.0f;
+	// The first two stages have too few butterflies per block to vectorise,
+	// and their twiddle factors are trivial
+	if (half >= 2) {
+		for (size_t i = 0; i < half; i += 2) {
+			float r = output_r[i + 1], im = output_i[i + 1];
+			output_r[i + 1] = output_r[i] - r;
+			output_i[i + 1] = output_i[i] - im;
+			output_r[i] += r;
+			output_i[i] += im;
+		}
 	}
+	if (half >= 4) {
+		for (size_t i = 0; i < half; i += 4) {
+			float r = output_r[i + 2], im = output_i[i + 2];
+			output_r[i + 2] = output_r[i] - r;
+			output_i[i + 2] = output_i[i] - im;
+			output_r[i] += r;
+			output_i[i] += im;
 
-	unsigned int BlockEnd = 1;
-	unsigned int BlockSize;
-	for (BlockSize = 2;BlockSize<=n_samples;BlockSize<<=1) {
-		// Calculate variables for this iteration
-		float delta_angle = angle_num / (float)BlockSize;
-		float sm2 = sin (-2 * delta_angle);
-		float sm1 = sin (-delta_angle);
-		float cm2 = cos (-2 * delta_angle);
-		float cm1 = cos (-delta_angle);
-		float w = 2 * cm1;
-		float ar0, ar1, ar2, ai0, ai1, ai2;
-
-		// Apply for every sample
-		for(i=0;i<n_samples;i+=BlockSize) {
-			ar1 = cm1;
-			ar2 = cm2;
-			ai1 = sm1;
-			ai2 = sm2;
-
-			for (j=i,n=0;n<BlockEnd;j++,n++) {
-				k = j + BlockEnd;
-
-				ar0 = w*ar1 - ar2;
-				ai0 = w*ai1 - ai2;
-				ar2 = ar1;
-				ai2 = ai1;
-				ar1 = ar0;
-				ai1 = ai0;
-
-				tr = ar0*output_r[k] - ai0*output_i[k];
-				ti = ar0*output_i[k] + ai0*output_r[k];
-
-				output_r[k] = output_r[j] - tr;
-				output_i[k] = output_i[j] - ti;
-
-				output_r[j] += tr;
-				output_i[j] += ti;
-			}
+			// Multiply by -i
+			r = output_i[i + 3];
+			im = -output_r[i + 3];
+			output_r[i + 3] = output_r[i + 1] - r;
+			output_i[i + 3] = output_i[i + 1] - im;
+			output_r[i + 1] += r;
+			output_i[i + 1] += im;
 		}
+	}
+	for (size_t h = 4; h < half; h <<= 1)
+		Butterflies(half, h, &plan.tw_r[h - 1], &plan.tw_i[h - 1], output_r, output_i);
+
+	// Split the transform of the packed input into the transform of the real
+	// input. Bins k and half - k depend on the same two complex values, so
+	// they're done together in place.
+	float z_r = output_r[0], z_i = output_i[0];
+	output_r[0] = z_r + z_i;
+	output_i[0] = 0.f;
+	output_r[half] = z_r - z_i;
+	output_i[half] = 0.f;
 
-		// Set next block end to current size
-		BlockEnd = BlockSize;
+	for (size_t k = 1; k <= half / 2; ++k) {
+		const size_t m = half - k;
+		const float a = output_r[k], b = output_i[k];
+		const float c = output_r[m], d = output_i[m];
+
+		const float e_r = (a + c) * .5f, e_i = (b - d) * .5f;
+		const float o_r = (b + d) * .5f, o_i = (c - a) * .5f;
+		const float w_r = plan.split_r[k], w_i = plan.split_i[k];
+
+		output_r[k] = e_r + w_r * o_r - w_i * o_i;
+		output_i[k] = e_i + w_r * o_i + w_i * o_r;
+		// exp(-2*pi*i*m/n) is -conj(w), and swapping k and m conjugates e and o
+		output_r[m] = e_r - w_r * o_r + w_i * o_i;
+		output_i[m] = -e_i + w_r * o_i + w_i * o_r;
 	}
 
-	// Divide everything by number of samples if it's an inverse transform
-	if (inverse) {
-		float denom = 1.0f/(float)n_samples;
-		for (i=0;i<n_samples;i++) {
-			output_r[i] *= denom;
-			output_i[i] *= denom;
-		}
+	// The spectrum of real input is conjugate-symmetric. The transforms here
+	// have always used exp(+2*pi*i*k/n) for the forward direction, so the
+	// forward transform is the conjugate of what was computed above.
+	const float scale = inverse ? 1.f / n_samples : 1.f;
+	const float sign = inverse ? scale : -scale;
+	for (size_t k = 1; k < half; ++k) {
+		output_r[n_samples - k] = output_r[k] * scale;
+		output_i[n_samples - k] = -output_i[k] * sign;
+	}
+	for (size_t k = 0; k <= half; ++k) {
+		output_r[k] *= scale;
+		output_i[k] *= sign;
 	}
 }
 
@@ -74,7 +74,8 @@ void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
 
 	bool overriden = false;
 
-	for (auto& block : line->ParseTags()) {
+	auto blocks = line->GetParsedTags();
+	for (auto& block : *blocks) {
 		switch (block->GetType()) {
 		case AssBlockType::OVERRIDE:
 			for (auto const& tag : static_cast<AssDialogueBlockOverride&>(*block).Tags) {
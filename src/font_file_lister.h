@@ -20,7 +20,9 @@
 #include <boost/filesystem/path.hpp>
 #include <functional>
 #include <map>
+#include <memory>
 #include <string>
+#include <tuple>
 #include <vector>
 #include <unordered_map>
 
@@ -84,18 +86,24 @@ using FontFileLister = CoreTextFontFileLister;
 
 typedef struct _FcConfig FcConfig;
 typedef struct _FcFontSet FcFontSet;
+typedef struct _FcPattern FcPattern;
 
 /// @class FontConfigFontFileLister
 /// @brief fontconfig powered font lister
 class FontConfigFontFileLister {
 	agi::scoped_holder<FcConfig*> config;
-
-	/// @brief Case-insensitive match ASS/SSA font family against full name. (also known as "name for humans")
-	/// @param family font fullname
-	/// @param bold weight attribute
-	/// @param italic italic attribute
-	/// @return font set
-	FcFontSet *MatchFullname(const char *family, int weight, int slant);
+	/// Lowercased family and full name -> outline fonts with that name, in
+	/// the order fontconfig lists them
+	std::unordered_map<std::string, std::vector<FcPattern*>> index;
+	/// (Lowercased family, weight, slant) -> best match, or null if none
+	std::map<std::tuple<std::string, int, int>, std::shared_ptr<FcPattern>> match_cache;
+
+	/// @brief Find the best match among the fonts with a given name
+	/// @param family Lowercased family or full name
+	/// @param weight fontconfig weight
+	/// @param slant fontconfig slant
+	/// @return Matching font, or null if there are no fonts with that name
+	std::shared_ptr<FcPattern> FindMatch(std::string const& family, int weight, int slant);
 public:
 	/// Constructor
 	/// @param cb Callback for status logging
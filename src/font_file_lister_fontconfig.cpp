@@ -19,32 +19,36 @@
 #include <libaegisub/charset_conv_win.h>
 #include <libaegisub/log.h>
 
+#include <algorithm>
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/filesystem/path.hpp>
 #include <fontconfig/fontconfig.h>
 #include <wx/intl.h>
 
 namespace {
-bool pattern_matches(FcPattern *pat, const char *field, std::string const& name) {
+void add_names(FcPattern *pat, const char *field, std::vector<std::string> &names) {
 	FcChar8 *str;
 	for (int i = 0; FcPatternGetString(pat, field, i, &str) == FcResultMatch; ++i) {
 		std::string sstr((char *)str);
 		boost::to_lower(sstr);
-		if (sstr == name)
-			return true;
+		if (find(begin(names), end(names), sstr) == end(names))
+			names.push_back(std::move(sstr));
 	}
-	return false;
 }
 
-void find_font(FcFontSet *src, FcFontSet *dst, std::string const& family) {
+void index_fonts(FcFontSet *src, std::unordered_map<std::string, std::vector<FcPattern*>> &index) {
 	if (!src) return;
 
+	std::vector<std::string> names;
 	for (FcPattern *pat : boost::make_iterator_range(&src->fonts[0], &src->fonts[src->nfont])) {
 		int val;
 		if (FcPatternGetBool(pat, FC_OUTLINE, 0, &val) != FcResultMatch || val != FcTrue) continue;
 
-		if (pattern_matches(pat, FC_FULLNAME, family) || pattern_matches(pat, FC_FAMILY, family))
-			FcFontSetAdd(dst, FcPatternDuplicate(pat));
+		names.clear();
+		add_names(pat, FC_FULLNAME, names);
+		add_names(pat, FC_FAMILY, names);
+		for (auto const& name : names)
+			index[name].push_back(pat);
 	}
 }
 
@@ -55,18 +59,20 @@ FontConfigFontFileLister::FontConfigFontFileLister(FontCollectorStatusCallback &
 {
 	cb(_("Updating font cache\n"), 0);
 	FcConfigBuildFonts(config);
+
+	index_fonts(FcConfigGetFonts(config, FcSetApplication), index);
+	index_fonts(FcConfigGetFonts(config, FcSetSystem), index);
 }
 
-CollectionResult FontConfigFontFileLister::GetFontPaths(std::string const& facename, int bold, bool italic, std::vector<int> const& characters) {
-	CollectionResult ret;
+std::shared_ptr<FcPattern> FontConfigFontFileLister::FindMatch(std::string const& family, int weight, int slant) {
+	std::shared_ptr<FcPattern> ret;
 
-	std::string family = facename[0] == '@' ? facename.substr(1) : facename;
-	boost::to_lower(family);
-
-	int weight = bold == 0 ? 80 :
-	             bold == 1 ? 200 :
-	                         bold;
-	int slant  = italic ? 110 : 0;
+	// Only the correctly named fonts are candidates. This is needed because
+	// the patterns returned by font matching only include the first family
+	// and fullname, so we can't always verify that we got the actual font we
+	// were asking for after the fact
+	auto fonts = index.find(family);
+	if (fonts == end(index)) return ret;
 
 	// Create a fontconfig pattern to match the desired weight/slant
 	agi::scoped_holder<FcPattern*> pat(FcPatternCreate(), FcPatternDestroy);
@@ -79,13 +85,11 @@ CollectionResult FontConfigFontFileLister::GetFontPaths(std::string const& facen
 	FcDefaultSubstitute(pat);
 	if (!FcConfigSubstitute(config, pat, FcMatchPattern)) return ret;
 
-	// Create a font set with only correctly named fonts
-	// This is needed because the patterns returned by font matching only
-	// include the first family and fullname, so we can't always verify that
-	// we got the actual font we were asking for after the fact
 	agi::scoped_holder<FcFontSet*> fset(FcFontSetCreate(), FcFontSetDestroy);
-	find_font(FcConfigGetFonts(config, FcSetApplication), fset, family);
-	find_font(FcConfigGetFonts(config, FcSetSystem), fset, family);
+	for (FcPattern *font : fonts->second) {
+		FcPatternReference(font);
+		FcFontSetAdd(fset, font);
+	}
 
 	// Get the best match from fontconfig
 	FcResult result;
@@ -95,7 +99,32 @@ CollectionResult FontConfigFontFileLister::GetFontPaths(std::string const& facen
 	if (matches->nfont == 0)
 		return ret;
 
-	auto match = matches->fonts[0];
+	FcPatternReference(matches->fonts[0]);
+	ret.reset(matches->fonts[0], FcPatternDestroy);
+	return ret;
+}
+
+CollectionResult FontConfigFontFileLister::GetFontPaths(std::string const& facename, int bold, bool italic, std::vector<int> const& characters) {
+	CollectionResult ret;
+
+	std::string family = facename[0] == '@' ? facename.substr(1) : facename;
+	boost::to_lower(family);
+
+	int weight = bold == 0 ? 80 :
+	             bold == 1 ? 200 :
+	                         bold;
+	int slant  = italic ? 110 : 0;
+
+	// Styles which differ only in the case of the name or an @ prefix end up
+	// looking for the same font
+	auto key = std::make_tuple(family, weight, slant);
+	auto it = match_cache.find(key);
+	if (it == end(match_cache))
+		it = match_cache.emplace(std::move(key), FindMatch(family, weight, slant)).first;
+	if (!it->second)
+		return ret;
+
+	auto match = it->second.get();
 
 	FcChar8 *file;
 	if(FcPatternGetString(match, FC_FILE, 0, &file) != FcResultMatch)
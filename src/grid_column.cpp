@@ -25,6 +25,8 @@
 
 #include <libaegisub/character_count.h>
 
+#include <climits>
+#include <map>
 #include <wx/dc.h>
 
 void WidthHelper::Age() {
@@ -86,6 +88,17 @@ void GridColumn::UpdateWidth(const agi::Context *c, WidthHelper &helper) {
 		width = 10 + std::max(width, helper(Header()));
 }
 
+void GridColumn::UpdateWidthForLine(const agi::Context *c, WidthHelper &helper, const AssDialogue *line) {
+	if (!visible) {
+		width = 0;
+		return;
+	}
+
+	width = WidthAfterChange(c, helper, line);
+	if (width)
+		width = 10 + std::max(width, helper(Header()));
+}
+
 void GridColumn::Paint(wxDC &dc, int x, int y, const AssDialogue *d, const agi::Context *c) const {
 	wxString str = Value(d, c);
 	if (Centered())
@@ -115,17 +128,71 @@ struct GridColumnLineNumber final : GridColumn {
 	}
 };
 
-template<typename T>
-T max_value(T AssDialogueBase::*field, EntryList<AssDialogue> const& lines) {
-	T value = 0;
-	for (AssDialogue const& line : lines) {
-		if (line.*field > value)
-			value = line.*field;
+/// Number of lines with each value of some per-line key, so that the
+/// largest can be found again after a line changes without looking at
+/// every other line in the file
+class key_histogram {
+	std::vector<int> line_keys; ///< Row -> key
+	std::map<int, int> key_counts; ///< Key -> number of lines
+
+	void remove(int key) {
+		auto it = key_counts.find(key);
+		if (--it->second == 0)
+			key_counts.erase(it);
 	}
-	return value;
-}
 
-struct GridColumnLayer final : GridColumn {
+public:
+	void clear() {
+		line_keys.clear();
+		key_counts.clear();
+	}
+
+	void set(size_t row, int key) {
+		if (row >= line_keys.size())
+			line_keys.resize(row + 1, INT_MIN);
+		int& old = line_keys[row];
+		if (old == key) return;
+		if (old != INT_MIN)
+			remove(old);
+		old = key;
+		++key_counts[key];
+	}
+
+	int max() const {
+		return key_counts.empty() ? 0 : key_counts.rbegin()->first;
+	}
+};
+
+/// Base class for columns whose width depends on the largest value of
+/// something about each line
+///
+/// Rows are only renumbered by commits which also make the grid recalculate
+/// every column's width, so keys are tracked per row between full updates.
+struct GridColumnField : GridColumn {
+	mutable key_histogram histogram;
+
+	/// Get the value to track for a line
+	virtual int Key(AssDialogue const& line, WidthHelper &helper) const = 0;
+	/// Get the column width given the largest key
+	virtual int KeyWidth(int max_key, WidthHelper &) const { return std::max(max_key, 0); }
+
+	int Width(const agi::Context *c, WidthHelper &helper) const override {
+		histogram.clear();
+		size_t row = 0;
+		for (AssDialogue const& line : c->ass->Events)
+			histogram.set(row++, Key(line, helper));
+		return KeyWidth(histogram.max(), helper);
+	}
+
+	int WidthAfterChange(const agi::Context *c, WidthHelper &helper, const AssDialogue *line) const override {
+		if (line->Row < 0)
+			return Width(c, helper);
+		histogram.set(line->Row, Key(*line, helper));
+		return KeyWidth(histogram.max(), helper);
+	}
+};
+
+struct GridColumnLayer final : GridColumnField {
 	COLUMN_HEADER(_("L"))
 	COLUMN_DESCRIPTION(_("Layer"))
 	bool Centered() const override { return true; }
@@ -134,69 +201,70 @@ struct GridColumnLayer final : GridColumn {
 		return d->Layer ? wxString(std::to_wstring(d->Layer)) : wxString();
 	}
 
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		int max_layer = max_value(&AssDialogue::Layer, c->ass->Events);
-		return max_layer == 0 ? 0 : helper(std::to_wstring(max_layer));
+	int Key(AssDialogue const& line, WidthHelper &) const override {
+		return line.Layer;
+	}
+
+	int KeyWidth(int max_layer, WidthHelper &helper) const override {
+		return max_layer <= 0 ? 0 : helper(std::to_wstring(max_layer));
 	}
 };
 
-struct GridColumnTime : GridColumn {
+struct GridColumnTime : GridColumnField {
+	agi::Time AssDialogueBase::*field;
+	agi::vfr::Time type;
 	bool by_frame = false;
 
+	GridColumnTime(agi::Time AssDialogueBase::*field, agi::vfr::Time type) : field(field), type(type) { }
+
 	bool Centered() const override { return true; }
 	void SetByFrame(bool by_frame) override { this->by_frame = by_frame; }
-};
-
-struct GridColumnStartTime final : GridColumnTime {
-	COLUMN_HEADER(_("Start"))
-	COLUMN_DESCRIPTION(_("Start Time"))
 
 	wxString Value(const AssDialogue *d, const agi::Context *c) const override {
 		if (by_frame)
-			return std::to_wstring(c->videoController->FrameAtTime(d->Start, agi::vfr::START));
-		return to_wx(d->Start.GetAssFormatted());
+			return std::to_wstring(c->videoController->FrameAtTime(d->*field, type));
+		return to_wx((d->*field).GetAssFormatted());
 	}
 
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		if (!by_frame)
-			return helper(wxS("0:00:00.00"));
-		int frame = c->videoController->FrameAtTime(max_value(&AssDialogue::Start, c->ass->Events), agi::vfr::START);
-		return helper(std::to_wstring(frame));
+	int Key(AssDialogue const& line, WidthHelper &) const override {
+		return line.*field;
 	}
-};
 
-struct GridColumnEndTime final : GridColumnTime {
-	COLUMN_HEADER(_("End"))
-	COLUMN_DESCRIPTION(_("End Time"))
-
-	wxString Value(const AssDialogue *d, const agi::Context *c) const override {
-		if (by_frame)
-			return std::to_wstring(c->videoController->FrameAtTime(d->End, agi::vfr::END));
-		return to_wx(d->End.GetAssFormatted());
+	/// Width of the frame number of the latest time in the file
+	int FrameWidth(const agi::Context *c, WidthHelper &helper) const {
+		return helper(std::to_wstring(c->videoController->FrameAtTime(std::max(histogram.max(), 0), type)));
 	}
 
+	// Times are only tracked while showing frame numbers; turning that on
+	// always does a full update
 	int Width(const agi::Context *c, WidthHelper &helper) const override {
 		if (!by_frame)
 			return helper(wxS("0:00:00.00"));
-		int frame = c->videoController->FrameAtTime(max_value(&AssDialogue::End, c->ass->Events), agi::vfr::END);
-		return helper(std::to_wstring(frame));
+		GridColumnField::Width(c, helper);
+		return FrameWidth(c, helper);
+	}
+
+	int WidthAfterChange(const agi::Context *c, WidthHelper &helper, const AssDialogue *line) const override {
+		if (!by_frame)
+			return helper(wxS("0:00:00.00"));
+		GridColumnField::WidthAfterChange(c, helper, line);
+		return FrameWidth(c, helper);
 	}
 };
 
-template<typename T>
-int max_width(T AssDialogueBase::*field, EntryList<AssDialogue> const& lines, WidthHelper &helper) {
-	int w = 0;
-	for (AssDialogue const& line : lines) {
-		auto const& v = line.*field;
-		if (v.get().empty()) continue;
-		int width = helper(v);
-		if (width > w)
-			w = width;
-	}
-	return w;
-}
+struct GridColumnStartTime final : GridColumnTime {
+	GridColumnStartTime() : GridColumnTime(&AssDialogueBase::Start, agi::vfr::START) { }
+	COLUMN_HEADER(_("Start"))
+	COLUMN_DESCRIPTION(_("Start Time"))
+};
 
-struct GridColumnStyle final : GridColumn {
+struct GridColumnEndTime final : GridColumnTime {
+	GridColumnEndTime() : GridColumnTime(&AssDialogueBase::End, agi::vfr::END) { }
+	COLUMN_HEADER(_("End"))
+	COLUMN_DESCRIPTION(_("End Time"))
+};
+
+struct GridColumnStyle final : GridColumnField {
 	COLUMN_HEADER(_("Style"))
 	COLUMN_DESCRIPTION(_("Style"))
 	bool Centered() const override { return false; }
@@ -205,12 +273,12 @@ struct GridColumnStyle final : GridColumn {
 		return to_wx(d->Style);
 	}
 
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		return max_width(&AssDialogue::Style, c->ass->Events, helper);
+	int Key(AssDialogue const& line, WidthHelper &helper) const override {
+		return helper(line.Style);
 	}
 };
 
-struct GridColumnEffect final : GridColumn {
+struct GridColumnEffect final : GridColumnField {
 	COLUMN_HEADER(_("Effect"))
 	COLUMN_DESCRIPTION(_("Effect"))
 	bool Centered() const override { return false; }
@@ -219,12 +287,12 @@ struct GridColumnEffect final : GridColumn {
 		return to_wx(d->Effect);
 	}
 
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		return max_width(&AssDialogue::Effect, c->ass->Events, helper);
+	int Key(AssDialogue const& line, WidthHelper &helper) const override {
+		return helper(line.Effect);
 	}
 };
 
-struct GridColumnActor final : GridColumn {
+struct GridColumnActor final : GridColumnField {
 	COLUMN_HEADER(_("Actor"))
 	COLUMN_DESCRIPTION(_("Actor"))
 	bool Centered() const override { return false; }
@@ -233,12 +301,12 @@ struct GridColumnActor final : GridColumn {
 		return to_wx(d->Actor);
 	}
 
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		return max_width(&AssDialogue::Actor, c->ass->Events, helper);
+	int Key(AssDialogue const& line, WidthHelper &helper) const override {
+		return helper(line.Actor);
 	}
 };
 
-struct GridColumnMargin : GridColumn {
+struct GridColumnMargin : GridColumnField {
 	int index;
 	GridColumnMargin(int index) : index(index) { }
 
@@ -248,13 +316,12 @@ struct GridColumnMargin : GridColumn {
 		return d->Margin[index] ? wxString(std::to_wstring(d->Margin[index])) : wxString();
 	}
 
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		int max = 0;
-		for (AssDialogue const& line : c->ass->Events) {
-			if (line.Margin[index] > max)
-				max = line.Margin[index];
-		}
-		return max == 0 ? 0 : helper(std::to_wstring(max));
+	int Key(AssDialogue const& line, WidthHelper &) const override {
+		return line.Margin[index];
+	}
+
+	int KeyWidth(int max, WidthHelper &helper) const override {
+		return max <= 0 ? 0 : helper(std::to_wstring(max));
 	}
 };
 
@@ -290,6 +357,25 @@ class GridColumnCPS final : public GridColumn {
 	const agi::OptionValue *cps_error = OPT_GET("Subtitle/Character Counter/CPS Error Threshold");
 	const agi::OptionValue *bg_color = OPT_GET("Colour/Subtitle Grid/CPS Error");
 
+	/// Character counts of recently painted lines, so that scrolling and
+	/// repainting the grid doesn't rerun the grapheme segmentation for
+	/// every visible line
+	mutable std::unordered_map<boost::flyweight<std::string>, size_t> counts;
+	/// Ignore flags the cached counts were computed with
+	mutable int counts_ignore = -1;
+
+	size_t CharacterCount(boost::flyweight<std::string> const& text, int ignore) const {
+		if (ignore != counts_ignore || counts.size() > 8192) {
+			counts.clear();
+			counts_ignore = ignore;
+		}
+
+		auto it = counts.find(text);
+		if (it != end(counts))
+			return it->second;
+		return counts[text] = agi::CharacterCount(text.get(), ignore);
+	}
+
 public:
 	COLUMN_HEADER(_("CPS"))
 	COLUMN_DESCRIPTION(_("Characters Per Second"))
@@ -302,9 +388,9 @@ public:
 
 	int CPS(const AssDialogue *d) const {
 		int duration = d->End - d->Start;
-		auto const& text = d->Text.get();
+		auto const& text = d->Text;
 
-		if (duration <= 100 || text.size() > static_cast<size_t>(duration))
+		if (duration <= 100 || text.get().size() > static_cast<size_t>(duration))
 			return -1;
 
 		int ignore = agi::IGNORE_BLOCKS;
@@ -313,7 +399,7 @@ public:
 		if (ignore_punctuation->GetBool())
 			ignore |= agi::IGNORE_PUNCTUATION;
 
-		return agi::CharacterCount(text, ignore) * 1000 / duration;
+		return CharacterCount(text, ignore) * 1000 / duration;
 	}
 
 	int Width(const agi::Context *c, WidthHelper &helper) const override {
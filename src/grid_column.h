@@ -55,6 +55,8 @@ protected:
 	bool visible = true;
 
 	virtual int Width(const agi::Context *c, WidthHelper &helper) const = 0;
+	/// Get the width when only the given line has changed since the last call to Width
+	virtual int WidthAfterChange(const agi::Context *c, WidthHelper &helper, const AssDialogue *) const { return Width(c, helper); }
 	virtual wxString Value(const AssDialogue *d, const agi::Context *c) const = 0;
 
 public:
@@ -72,6 +74,8 @@ public:
 	bool Visible() const { return visible; }
 
 	virtual void UpdateWidth(const agi::Context *c, WidthHelper &helper);
+	/// Update the width when only the given line has changed since the last update
+	void UpdateWidthForLine(const agi::Context *c, WidthHelper &helper, const AssDialogue *line);
 	virtual void SetByFrame(bool /* by_frame */) { }
 	void SetVisible(bool new_value) { visible = new_value; }
 };
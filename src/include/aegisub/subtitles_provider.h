@@ -38,6 +38,7 @@
 #include <string>
 #include <vector>
 
+class AssDialogue;
 class AssFile;
 struct VideoFrame;
 
@@ -47,7 +48,12 @@ class SubtitlesProvider {
 
 public:
 	virtual ~SubtitlesProvider() = default;
-	void LoadSubtitles(AssFile *subs, int time = -1);
+	/// Load a subtitle file, or just the lines visible at time if time >= 0
+	virtual void LoadSubtitles(AssFile *subs, int time = -1);
+	/// Replace a single line of the previously loaded file with a new version
+	/// of it, identified by its Row
+	/// @return false if the provider can't do this and the file must be reloaded
+	virtual bool UpdateLine(AssDialogue const&) { return false; }
 	virtual void DrawSubtitles(VideoFrame &dst, double time)=0;
 	virtual void Reinitialize() { }
 };
@@ -378,6 +378,7 @@ void Advanced_Audio(wxTreebook *book, Preferences *parent) {
 	wxArrayString ct_choice(3, ct_arr);
 	p->OptionChoice(cache, _("Cache type"), ct_choice, "Audio/Cache/Type");
 	p->OptionBrowse(cache, _("Path"), "Audio/Cache/HD/Location");
+	p->OptionAdd(cache, _("Keep waveform and spectrum data between sessions"), "Audio/Cache/Summary/Enabled");
 
 	auto spectrum = p->PageSizer(_("Spectrum"));
 
@@ -443,6 +444,9 @@ void Advanced_Video(wxTreebook *book, Preferences *parent) {
 	wxArrayString sp_choice = to_wx(SubtitlesProviderFactory::GetClasses());
 	p->OptionChoice(expert, _("Subtitles provider"), sp_choice, "Subtitle/Provider");
 
+	p->OptionAdd(expert, _("Cache memory max (MB)"), "Provider/Video/Cache/Size", 0, 16384);
+	p->OptionAdd(expert, _("Frames to decode ahead"), "Provider/Video/Cache/Prefetch", 0, 256);
+
 #ifdef WITH_AVISYNTH
 	auto avisynth = p->PageSizer("Avisynth");
 	p->OptionAdd(avisynth, _("Allow pre-2.56a Avisynth"), "Provider/Avisynth/Allow Ancient");
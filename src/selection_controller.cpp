@@ -23,16 +23,256 @@
 
 #include <algorithm>
 
-SelectionController::SelectionController(agi::Context *c) : context(c) { }
+namespace {
+const size_t word_bits = 64;
+
+inline size_t count_trailing_zeros(uint64_t word) {
+#ifdef __GNUC__
+	return __builtin_ctzll(word);
+#else
+	size_t n = 0;
+	for (; !(word & 1); word >>= 1) ++n;
+	return n;
+#endif
+}
+
+inline size_t popcount(uint64_t word) {
+#ifdef __GNUC__
+	return __builtin_popcountll(word);
+#else
+	word = word - ((word >> 1) & 0x5555555555555555ULL);
+	word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+	word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (word * 0x0101010101010101ULL) >> 56;
+#endif
+}
+
+/// Mask of the bits [first, first + n) of a word
+inline uint64_t bit_range(size_t first, size_t n) {
+	return (n == word_bits ? ~uint64_t(0) : (uint64_t(1) << n) - 1) << first;
+}
+
+/// Is line at the given row of rows?
+inline bool in_file(std::vector<AssDialogue *> const& rows, AssDialogue *line) {
+	return line && line->Row >= 0 && (size_t)line->Row < rows.size() && rows[line->Row] == line;
+}
+}
+
+Selection::iterator& Selection::iterator::operator++() {
+	if (idx < sel->lines.size()) {
+		idx = sel->Next(idx + 1);
+		it = sel->overflow.begin();
+	}
+	else
+		++it;
+	return *this;
+}
+
+size_t Selection::Next(size_t idx) const {
+	size_t word = idx / word_bits;
+	if (word >= bits.size()) return lines.size();
+
+	uint64_t bitmap = bits[word] & (~uint64_t(0) << (idx % word_bits));
+	while (!bitmap) {
+		if (++word == bits.size()) return lines.size();
+		bitmap = bits[word];
+	}
+	return word * word_bits + count_trailing_zeros(bitmap);
+}
+
+void Selection::Cover(size_t first, size_t last) {
+	first -= first % word_bits;
+	last += (word_bits - last % word_bits) % word_bits;
+	if (lines.empty()) {
+		first_row = first;
+		bits.resize((last - first) / word_bits);
+		lines.resize(last - first);
+		return;
+	}
+
+	if (first < first_row) {
+		size_t words = (first_row - first) / word_bits;
+		bits.insert(bits.begin(), words, 0);
+		lines.insert(lines.begin(), words * word_bits, nullptr);
+		first_row = first;
+	}
+	if (last > first_row + lines.size()) {
+		bits.resize((last - first_row) / word_bits);
+		lines.resize(last - first_row);
+	}
+}
+
+size_t Selection::Slot(AssDialogue *line) const {
+	if (!line || line->Row < 0) return lines.size();
+	size_t row = line->Row;
+	if (row < first_row || row - first_row >= lines.size()) return lines.size();
+	return lines[row - first_row] == line ? row - first_row : lines.size();
+}
+
+size_t Selection::count(AssDialogue *line) const {
+	if (Slot(line) != lines.size()) return 1;
+	return overflow.empty() ? 0 : overflow.count(line);
+}
+
+std::pair<Selection::iterator, bool> Selection::insert(AssDialogue *line) {
+	if (line && line->Row >= 0) {
+		size_t row = line->Row;
+		Cover(row, row + 1);
+		size_t idx = row - first_row;
+		if (lines[idx] == line)
+			return {iterator(this, idx, overflow.begin()), false};
+		if (!lines[idx]) {
+			// The line may have been added to the overflow set before it had a row
+			bool was_selected = !overflow.empty() && overflow.erase(line);
+			lines[idx] = line;
+			bits[idx / word_bits] |= uint64_t(1) << (idx % word_bits);
+			if (!was_selected)
+				++selected;
+			return {iterator(this, idx, overflow.begin()), !was_selected};
+		}
+	}
+
+	auto res = overflow.insert(line);
+	if (res.second)
+		++selected;
+	return {iterator(this, lines.size(), res.first), res.second};
+}
+
+size_t Selection::erase(AssDialogue *line) {
+	size_t idx = Slot(line);
+	if (idx != lines.size()) {
+		lines[idx] = nullptr;
+		bits[idx / word_bits] &= ~(uint64_t(1) << (idx % word_bits));
+		--selected;
+		return 1;
+	}
+	if (!overflow.empty() && overflow.erase(line)) {
+		--selected;
+		return 1;
+	}
+	return 0;
+}
+
+void Selection::clear() {
+	first_row = 0;
+	bits.clear();
+	lines.clear();
+	overflow.clear();
+	selected = 0;
+}
+
+void Selection::InsertRange(std::vector<AssDialogue *> const& rows, size_t first, size_t last) {
+	last = std::min(last, rows.size());
+	if (first >= last) return;
+
+	Reindex(rows);
+	Cover(first, last);
+	for (size_t row = first; row < last; ) {
+		size_t idx = row - first_row;
+		size_t n = std::min(word_bits - idx % word_bits, last - row);
+		bits[idx / word_bits] |= bit_range(idx % word_bits, n);
+		row += n;
+	}
+	std::copy(rows.begin() + first, rows.begin() + last, lines.begin() + (first - first_row));
+
+	selected = overflow.size();
+	for (auto word : bits)
+		selected += popcount(word);
+}
+
+void Selection::Invert(std::vector<AssDialogue *> const& rows) {
+	Reindex(rows);
+	overflow.clear();
+	if (rows.empty()) {
+		clear();
+		return;
+	}
+
+	Cover(0, rows.size());
+	// Anything beyond the end of the file is not in the file and so is deselected
+	bits.resize((rows.size() + word_bits - 1) / word_bits);
+	lines.resize(bits.size() * word_bits);
+
+	selected = 0;
+	for (size_t word = 0; word < bits.size(); ++word) {
+		size_t n = std::min(word_bits, rows.size() - word * word_bits);
+		bits[word] = ~bits[word] & bit_range(0, n);
+		selected += popcount(bits[word]);
+		for (size_t bit = 0; bit < n; ++bit) {
+			size_t row = word * word_bits + bit;
+			lines[row] = (bits[word] & (uint64_t(1) << bit)) ? rows[row] : nullptr;
+		}
+	}
+}
+
+void Selection::Reindex(std::vector<AssDialogue *> const& rows) {
+	// Usually nothing has moved, so check that first without touching the lines
+	bool current = overflow.empty();
+	for (size_t word = 0; current && word < bits.size(); ++word) {
+		for (uint64_t bitmap = bits[word]; bitmap; bitmap &= bitmap - 1) {
+			size_t row = first_row + word * word_bits + count_trailing_zeros(bitmap);
+			if (row >= rows.size() || rows[row] != lines[row - first_row]) {
+				current = false;
+				break;
+			}
+		}
+	}
+	if (current) return;
+
+	Selection reindexed;
+	size_t min_row = rows.size(), max_row = 0;
+	for (auto line : *this) {
+		if (in_file(rows, line)) {
+			min_row = std::min<size_t>(min_row, line->Row);
+			max_row = std::max<size_t>(max_row, line->Row);
+		}
+	}
+	if (min_row <= max_row)
+		reindexed.Cover(min_row, max_row + 1);
+
+	for (auto line : *this) {
+		if (in_file(rows, line))
+			reindexed.insert(line);
+		else if (reindexed.overflow.insert(line).second)
+			++reindexed.selected;
+	}
+	*this = std::move(reindexed);
+}
+
+bool Selection::operator==(Selection const& rgt) const {
+	if (size() != rgt.size()) return false;
+	for (auto line : *this) {
+		if (!rgt.count(line))
+			return false;
+	}
+	return true;
+}
+
+SelectionController::SelectionController(agi::Context *c)
+: context(c)
+, renumber_connection(c->ass->AddRenumberListener(&SelectionController::OnRenumber, this))
+{
+}
+
+void SelectionController::OnRenumber() {
+	rows.clear();
+	rows.reserve(context->ass->Events.size());
+	for (auto& line : context->ass->Events)
+		rows.push_back(&line);
+	selection.Reindex(rows);
+}
 
 void SelectionController::SetSelectedSet(Selection new_selection) {
+	new_selection.Reindex(rows);
 	selection = std::move(new_selection);
+	++generation;
 	AnnounceSelectedSetChanged();
 }
 
 void SelectionController::SetActiveLine(AssDialogue *new_line) {
 	if (new_line != active_line) {
 		active_line = new_line;
+		++generation;
 		if (active_line)
 			context->ass->Properties.active_row = active_line->Row;
 		AnnounceActiveLineChanged(new_line);
@@ -41,8 +281,10 @@ void SelectionController::SetActiveLine(AssDialogue *new_line) {
 
 void SelectionController::SetSelectionAndActive(Selection new_selection, AssDialogue *new_line) {
 	bool active_line_changed = new_line != active_line;
+	new_selection.Reindex(rows);
 	selection = std::move(new_selection);
 	active_line = new_line;
+	++generation;
 	if (active_line)
 		context->ass->Properties.active_row = active_line->Row;
 
@@ -52,9 +294,29 @@ void SelectionController::SetSelectionAndActive(Selection new_selection, AssDial
 }
 
 std::vector<AssDialogue *> SelectionController::GetSortedSelection() const {
-	std::vector<AssDialogue *> ret(selection.begin(), selection.end());
-	sort(begin(ret), end(ret), [](AssDialogue *a, AssDialogue *b) { return a->Row < b->Row; });
-	return ret;
+	// The selection is indexed by row number, so it's already in order
+	return std::vector<AssDialogue *>(selection.begin(), selection.end());
+}
+
+void SelectionController::SelectAll() {
+	Selection new_selection;
+	new_selection.InsertRange(rows, 0, rows.size());
+	SetSelectedSet(std::move(new_selection));
+}
+
+void SelectionController::InvertSelection() {
+	Selection new_selection = selection;
+	new_selection.Invert(rows);
+	SetSelectedSet(std::move(new_selection));
+}
+
+void SelectionController::SelectRange(int first, int last, bool add) {
+	if (first > last) std::swap(first, last);
+	Selection new_selection;
+	if (add)
+		new_selection = selection;
+	new_selection.InsertRange(rows, std::max(first, 0), last + 1);
+	SetSelectedSet(std::move(new_selection));
 }
 
 void SelectionController::PrevLine() {
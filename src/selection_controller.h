@@ -29,14 +29,120 @@
 
 #include <libaegisub/signal.h>
 
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
 #include <set>
+#include <utility>
 #include <vector>
 
 class AssDialogue;
-typedef std::set<AssDialogue *> Selection;
 
 namespace agi { struct Context; }
 
+/// @class Selection
+/// @brief A set of dialogue lines
+///
+/// Selected lines are stored in a dense bitmap indexed by row number, so
+/// membership tests are O(1), whole ranges of rows can be selected or
+/// inverted a word at a time, and iteration visits the lines in file order.
+///
+/// A line's row number is read when it is inserted. Lines which do not have
+/// a usable row number yet (because they have not been committed, or because
+/// another selected line already holds that row) are kept in a separate set
+/// and visited after all of the indexed lines, until Reindex() is called with
+/// the current row map.
+class Selection {
+	/// Row number of the first entry in the bitmap; always a multiple of 64
+	size_t first_row = 0;
+	/// Bit n of word w is set if row first_row + w * 64 + n is selected
+	std::vector<uint64_t> bits;
+	/// The selected line at each row covered by the bitmap, or nullptr
+	std::vector<AssDialogue *> lines;
+	/// Selected lines which could not be indexed by row number
+	std::set<AssDialogue *> overflow;
+	/// Total number of selected lines
+	size_t selected = 0;
+
+	/// Index of the first selected entry in lines at or after idx, or lines.size() if none
+	size_t Next(size_t idx) const;
+	/// Grow the bitmap to cover the rows [first, last)
+	void Cover(size_t first, size_t last);
+	/// Index into lines which holds line, or lines.size() if it isn't indexed
+	size_t Slot(AssDialogue *line) const;
+
+public:
+	class iterator : public std::iterator<std::forward_iterator_tag, AssDialogue *, std::ptrdiff_t, AssDialogue *const *, AssDialogue *const&> {
+		friend class Selection;
+		Selection const *sel = nullptr;
+		/// Index into lines, or lines.size() once the iteration has reached the overflow set
+		size_t idx = 0;
+		std::set<AssDialogue *>::const_iterator it;
+
+		iterator(Selection const *sel, size_t idx, std::set<AssDialogue *>::const_iterator it)
+		: sel(sel), idx(idx), it(it) { }
+	public:
+		iterator() = default;
+
+		AssDialogue *const& operator*() const { return idx < sel->lines.size() ? sel->lines[idx] : *it; }
+		iterator& operator++();
+		iterator operator++(int) { iterator ret = *this; ++*this; return ret; }
+		bool operator==(iterator const& rgt) const { return idx == rgt.idx && (idx < sel->lines.size() || it == rgt.it); }
+		bool operator!=(iterator const& rgt) const { return !(*this == rgt); }
+	};
+	typedef iterator const_iterator;
+	typedef AssDialogue *value_type;
+	typedef AssDialogue *const& reference;
+	typedef AssDialogue *const& const_reference;
+	typedef size_t size_type;
+
+	Selection() = default;
+	Selection(std::initializer_list<AssDialogue *> init) { insert(init.begin(), init.end()); }
+
+	iterator begin() const { return iterator(this, Next(0), overflow.begin()); }
+	iterator end() const { return iterator(this, lines.size(), overflow.end()); }
+
+	size_t size() const { return selected; }
+	bool empty() const { return selected == 0; }
+	/// Check if line is selected. This reads the line's row number, so line
+	/// must not have been deleted.
+	size_t count(AssDialogue *line) const;
+
+	std::pair<iterator, bool> insert(AssDialogue *line);
+	/// Hinted insert for std::inserter; the hint is ignored
+	iterator insert(iterator, AssDialogue *line) { return insert(line).first; }
+	template<typename Iterator>
+	void insert(Iterator first, Iterator last) {
+		for (; first != last; ++first)
+			insert(*first);
+	}
+	size_t erase(AssDialogue *line);
+	void clear();
+
+	/// @brief Select a contiguous block of rows
+	/// @param rows Every dialogue line in the file, indexed by row number
+	/// @param first First row to select
+	/// @param last One past the last row to select
+	void InsertRange(std::vector<AssDialogue *> const& rows, size_t first, size_t last);
+
+	/// @brief Select exactly the lines which are not currently selected
+	/// @param rows Every dialogue line in the file, indexed by row number
+	///
+	/// Selected lines which are not in the file are deselected.
+	void Invert(std::vector<AssDialogue *> const& rows);
+
+	/// @brief Re-read the row numbers of the selected lines
+	/// @param rows Every dialogue line in the file, indexed by row number
+	///
+	/// This must be called after lines are renumbered for membership tests
+	/// and iteration order to be correct. Lines which are not in the file are
+	/// kept in the overflow set.
+	void Reindex(std::vector<AssDialogue *> const& rows);
+
+	bool operator==(Selection const& rgt) const;
+	bool operator!=(Selection const& rgt) const { return !(*this == rgt); }
+};
+
 class SelectionController {
 	agi::signal::Signal<AssDialogue *> AnnounceActiveLineChanged;
 	agi::signal::Signal<> AnnounceSelectedSetChanged;
@@ -44,7 +150,14 @@ class SelectionController {
 	agi::Context *context;
 
 	Selection selection; ///< Currently selected lines
+	std::vector<AssDialogue *> rows; ///< Row number -> dialogue line, as of the last commit which renumbered lines
 	AssDialogue *active_line = nullptr; ///< The currently active line or 0 if none
+	int generation = 0; ///< Number of times the selection or active line has changed
+
+	agi::signal::Connection renumber_connection;
+
+	/// Reindex the selection after the lines in the file were renumbered
+	void OnRenumber();
 
 public:
 	SelectionController(agi::Context *context);
@@ -84,6 +197,24 @@ public:
 	/// Get the selection sorted by row number
 	std::vector<AssDialogue *> GetSortedSelection() const;
 
+	/// Select every dialogue line
+	void SelectAll();
+
+	/// Select every dialogue line which isn't selected and deselect the ones which are
+	void InvertSelection();
+
+	/// @brief Select a range of rows
+	/// @param first First row to select
+	/// @param last Last row to select, inclusive
+	/// @param add Add the rows to the existing selection rather than replacing it
+	void SelectRange(int first, int last, bool add = false);
+
+	/// @brief Get a counter which changes whenever the selected set or active line does
+	///
+	/// Useful for caching things which depend on the selection without
+	/// having to compare the whole selected set.
+	int Generation() const { return generation; }
+
 	/// @brief Set both the selected set and active line
 	/// @param new_line Subtitle line to become the new active line
 	/// @param new_selection The set of subtitle lines to become the new selected set
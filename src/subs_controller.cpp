@@ -21,6 +21,7 @@
 #include "ass_file.h"
 #include "ass_info.h"
 #include "ass_style.h"
+#include "autosave_journal.h"
 #include "compat.h"
 #include "command/command.h"
 #include "format.h"
@@ -38,6 +39,10 @@
 #include <libaegisub/path.h>
 #include <libaegisub/util.h>
 
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+
 #include <wx/msgdlg.h>
 
 namespace {
@@ -48,44 +53,218 @@ namespace {
 		else
 			timer->Stop();
 	}
+
+	/// Number of dialogue lines in each separately shared chunk of an undo state
+	const size_t undo_chunk_size = 256;
+
+	bool same_line(AssDialogueBase const& a, AssDialogueBase const& b) {
+		// The string fields are flyweights, so these are all cheap comparisons
+		return a.Id == b.Id
+			&& a.Comment == b.Comment
+			&& a.Layer == b.Layer
+			&& a.Margin == b.Margin
+			&& a.Start == b.Start
+			&& a.End == b.End
+			&& a.Style == b.Style
+			&& a.Actor == b.Actor
+			&& a.Effect == b.Effect
+			&& a.ExtradataIds == b.ExtradataIds
+			&& a.Text == b.Text;
+	}
+
+	bool same_entry(std::pair<std::string, std::string> const& a, AssInfo const& b) {
+		return a.first == b.Key() && a.second == b.Value();
+	}
+
+	bool same_entry(AssStyle const& a, AssStyle const& b) {
+		return a.GetEntryData() == b.GetEntryData();
+	}
+
+	bool same_entry(AssAttachment const& a, AssAttachment const& b) {
+		return a.Group() == b.Group()
+			&& (&a.GetEntryData() == &b.GetEntryData() || a.GetEntryData() == b.GetEntryData());
+	}
+
+	bool same_entry(ExtradataEntry const& a, ExtradataEntry const& b) {
+		return a.id == b.id && a.key == b.key && a.value == b.value;
+	}
+
+	/// Get a snapshot of a section of the file, reusing the previous snapshot
+	/// if the section hasn't changed since it was taken
+	template<typename T, typename Container>
+	std::shared_ptr<const std::vector<T>> snapshot(std::shared_ptr<const std::vector<T>> const& prev, Container const& current) {
+		if (prev && prev->size() == current.size()
+			&& std::equal(prev->begin(), prev->end(), current.begin(),
+				[](T const& a, typename Container::value_type const& b) { return same_entry(a, b); }))
+			return prev;
+		return std::make_shared<std::vector<T>>(current.begin(), current.end());
+	}
+
+	std::shared_ptr<const std::vector<std::pair<std::string, std::string>>> snapshot_info(
+		std::shared_ptr<const std::vector<std::pair<std::string, std::string>>> const& prev,
+		std::vector<AssInfo> const& current)
+	{
+		if (prev && prev->size() == current.size()
+			&& std::equal(prev->begin(), prev->end(), current.begin(),
+				[](std::pair<std::string, std::string> const& a, AssInfo const& b) { return same_entry(a, b); }))
+			return prev;
+
+		auto info = std::make_shared<std::vector<std::pair<std::string, std::string>>>();
+		info->reserve(current.size());
+		for (auto const& line : current)
+			info->emplace_back(line.Key(), line.Value());
+		return info;
+	}
 }
 
+/// A version of the file on the undo or redo stack
+///
+/// Each section of the file, and each chunk of dialogue lines, is shared
+/// with the neighbouring versions when it is unchanged between them, and
+/// unchanged lines within a changed chunk are shared as well. Memory use
+/// and the time taken to push a new version thus depend on what was
+/// changed rather than on the size of the file.
 struct SubsController::UndoInfo {
 	wxString undo_description;
 	int commit_id;
 
-	std::vector<std::pair<std::string, std::string>> script_info;
-	std::vector<AssStyle> styles;
-	std::vector<AssDialogueBase> events;
-	std::vector<AssAttachment> attachments;
-	std::vector<ExtradataEntry> extradata;
+	std::shared_ptr<const std::vector<std::pair<std::string, std::string>>> script_info;
+	std::shared_ptr<const std::vector<AssStyle>> styles;
+	std::vector<std::shared_ptr<const EventChunk>> events;
+	std::shared_ptr<const std::vector<AssAttachment>> attachments;
+	std::shared_ptr<const std::vector<ExtradataEntry>> extradata;
+	size_t event_count = 0;
 
 	mutable std::vector<int> selection;
 	int active_line_id = 0;
 	int pos = 0, sel_start = 0, sel_end = 0;
 
-	UndoInfo(const agi::Context *c, wxString const& d, int commit_id)
+	/// @param c Context to take the current state from
+	/// @param d Undo description
+	/// @param commit_id Commit id of this version
+	/// @param prev Previous version to share data with, if any
+	/// @param single_line The only line changed since prev, if only one was
+	UndoInfo(const agi::Context *c, wxString const& d, int commit_id, const UndoInfo *prev, const AssDialogue *single_line)
 	: undo_description(d)
 	, commit_id(commit_id)
-	, attachments(c->ass->Attachments)
-	, extradata(c->ass->Extradata)
 	{
-		script_info.reserve(c->ass->Info.size());
-		for (auto const& info : c->ass->Info)
-			script_info.emplace_back(info.Key(), info.Value());
-
-		styles.reserve(c->ass->Styles.size());
-		styles.assign(c->ass->Styles.begin(), c->ass->Styles.end());
-
-		events.reserve(c->ass->Events.size());
-		events.assign(c->ass->Events.begin(), c->ass->Events.end());
+		script_info = snapshot_info(prev ? prev->script_info : nullptr, c->ass->Info);
+		styles = snapshot(prev ? prev->styles : nullptr, c->ass->Styles);
+		attachments = snapshot(prev ? prev->attachments : nullptr, c->ass->Attachments);
+		extradata = snapshot(prev ? prev->extradata : nullptr, c->ass->Extradata);
+
+		event_count = c->ass->Events.size();
+		bool replaced = false;
+		if (prev && single_line && prev->event_count == event_count) {
+			// Only the one line can differ from the previous version
+			events = prev->events;
+			replaced = ReplaceLine(*single_line);
+		}
+		if (!replaced)
+			SnapshotEvents(c->ass->Events, prev);
 
 		UpdateActiveLine(c);
 		UpdateSelection(c);
 		UpdateTextSelection(c);
 	}
 
+	/// Take a snapshot of every dialogue line, sharing the unchanged lines and
+	/// chunks of lines with prev
+	void SnapshotEvents(EntryList<AssDialogue> const& current, const UndoInfo *prev) {
+		events.clear();
+		events.reserve((event_count + undo_chunk_size - 1) / undo_chunk_size);
+
+		// Only built if lines have moved between chunks
+		std::unordered_map<int, std::shared_ptr<const AssDialogueBase>> prev_lines;
+		auto find_prev = [&](AssDialogue const& line) -> std::shared_ptr<const AssDialogueBase> {
+			if (!prev) return nullptr;
+			if (prev_lines.empty()) {
+				for (auto const& chunk : prev->events) {
+					for (auto const& prev_line : *chunk)
+						prev_lines[prev_line->Id] = prev_line;
+				}
+			}
+			auto it = prev_lines.find(line.Id);
+			if (it != prev_lines.end() && same_line(*it->second, line))
+				return it->second;
+			return nullptr;
+		};
+
+		std::vector<AssDialogue const*> lines;
+		lines.reserve(undo_chunk_size);
+		auto it = current.begin();
+		while (it != current.end()) {
+			lines.clear();
+			for (; it != current.end() && lines.size() < undo_chunk_size; ++it)
+				lines.push_back(&*it);
+
+			const EventChunk *prev_chunk = nullptr;
+			if (prev && events.size() < prev->events.size())
+				prev_chunk = prev->events[events.size()].get();
+
+			// Reuse the whole chunk if none of its lines have changed
+			if (prev_chunk && prev_chunk->size() == lines.size()
+				&& std::equal(lines.begin(), lines.end(), prev_chunk->begin(),
+					[](AssDialogue const* a, std::shared_ptr<const AssDialogueBase> const& b) { return same_line(*a, *b); })) {
+				events.push_back(prev->events[events.size()]);
+				continue;
+			}
+
+			auto chunk = std::make_shared<EventChunk>();
+			chunk->reserve(lines.size());
+			for (size_t i = 0; i < lines.size(); ++i) {
+				if (prev_chunk && i < prev_chunk->size() && same_line(*lines[i], *(*prev_chunk)[i]))
+					chunk->push_back((*prev_chunk)[i]);
+				else if (auto prev_line = find_prev(*lines[i]))
+					chunk->push_back(prev_line);
+				else
+					chunk->push_back(std::make_shared<AssDialogueBase>(*lines[i]));
+			}
+			events.push_back(chunk);
+		}
+	}
+
+	/// Replace the stored copy of a line with its current state
+	/// @return Was the line found?
+	bool ReplaceLine(AssDialogue const& line) {
+		// Row is kept up to date by AssFile::Commit whenever lines are added,
+		// removed or reordered, so it's normally the line's index
+		if (events.empty()) return false;
+
+		size_t chunk_index = 0, line_index = 0;
+		auto found = [&] { return (*events[chunk_index])[line_index]->Id == line.Id; };
+		if (line.Row >= 0 && (size_t)line.Row < event_count) {
+			chunk_index = line.Row / undo_chunk_size;
+			line_index = line.Row % undo_chunk_size;
+		}
+		if (!found()) {
+			auto it = std::find_if(events.begin(), events.end(), [&](std::shared_ptr<const EventChunk> const& chunk) {
+				auto line_it = std::find_if(chunk->begin(), chunk->end(),
+					[&](std::shared_ptr<const AssDialogueBase> const& l) { return l->Id == line.Id; });
+				line_index = line_it - chunk->begin();
+				return line_it != chunk->end();
+			});
+			if (it == events.end()) return false;
+			chunk_index = it - events.begin();
+		}
+
+		// Chunks may be shared with other versions, so copy rather than modify
+		if (!same_line(*(*events[chunk_index])[line_index], line)) {
+			auto chunk = std::make_shared<EventChunk>(*events[chunk_index]);
+			(*chunk)[line_index] = std::make_shared<AssDialogueBase>(line);
+			events[chunk_index] = chunk;
+		}
+		return true;
+	}
+
 	void Apply(agi::Context *c) const {
+		// Lines which are the same in this version as in the current file are
+		// kept as-is rather than being recreated
+		std::unordered_map<int, AssDialogue *> current_lines;
+		current_lines.reserve(c->ass->Events.size());
+		for (auto& line : c->ass->Events)
+			current_lines.emplace(line.Id, &line);
+
 		// Keep old dialogue lines alive until after the commit is complete
 		// since a bunch of stuff holds references to them
 		AssFile old;
@@ -100,20 +279,31 @@ struct SubsController::UndoInfo {
 		AssDialogue *active_line = nullptr;
 		Selection new_sel;
 
-		for (auto const& info : script_info)
+		for (auto const& info : *script_info)
 			c->ass->Info.push_back(*new AssInfo(info.first, info.second));
-		for (auto const& style : styles)
+		for (auto const& style : *styles)
 			c->ass->Styles.push_back(*new AssStyle(style));
-		c->ass->Attachments = attachments;
-		for (auto const& event : events) {
-			auto copy = new AssDialogue(event);
-			c->ass->Events.push_back(*copy);
-			if (copy->Id == active_line_id)
-				active_line = copy;
-			if (binary_search(begin(selection), end(selection), copy->Id))
-				new_sel.insert(copy);
+		c->ass->Attachments = *attachments;
+		for (auto const& chunk : events) {
+			for (auto const& event : *chunk) {
+				AssDialogue *line;
+				auto it = current_lines.find(event->Id);
+				if (it != current_lines.end() && same_line(*it->second, *event)) {
+					line = it->second;
+					old.Events.erase(old.Events.iterator_to(*line));
+					current_lines.erase(it);
+				}
+				else
+					line = new AssDialogue(*event);
+
+				c->ass->Events.push_back(*line);
+				if (line->Id == active_line_id)
+					active_line = line;
+				if (binary_search(begin(selection), end(selection), line->Id))
+					new_sel.insert(line);
+			}
 		}
-		c->ass->Extradata = extradata;
+		c->ass->Extradata = *extradata;
 
 		c->ass->Commit("", AssFile::COMMIT_NEW);
 		c->selectionController->SetSelectionAndActive(std::move(new_sel), active_line);
@@ -122,6 +312,20 @@ struct SubsController::UndoInfo {
 		c->textSelectionController->SetSelection(sel_start, sel_end);
 	}
 
+	/// Get a copy of this version of the file to autosave, sharing everything
+	/// with this version
+	AutosaveSnapshot Snapshot(const AssFile *file) const {
+		AutosaveSnapshot snapshot;
+		snapshot.script_info = script_info;
+		snapshot.styles = styles;
+		snapshot.events = events;
+		snapshot.attachments = attachments;
+		snapshot.extradata = extradata;
+		// Not part of the undo state, so always taken from the current file
+		snapshot.properties = std::make_shared<ProjectProperties>(file->Properties);
+		return snapshot;
+	}
+
 	void UpdateActiveLine(const agi::Context *c) {
 		auto line = c->selectionController->GetActiveLine();
 		if (line)
@@ -148,6 +352,7 @@ SubsController::SubsController(agi::Context *context)
 , undo_connection(context->ass->AddUndoManager(&SubsController::OnCommit, this))
 , text_selection_connection(context->textSelectionController->AddSelectionListener(&SubsController::OnTextSelectionChanged, this))
 , autosave_queue(agi::dispatch::Create())
+, autosave_journal(std::make_shared<AutosaveJournal>())
 {
 	autosave_timer_changed(&autosave_timer);
 	OPT_SUB("App/Auto/Save", [=] { autosave_timer_changed(&autosave_timer); });
@@ -177,6 +382,7 @@ ProjectProperties SubsController::Load(agi::fs::path const& filename, std::strin
 
 	// Push the initial state of the file onto the undo stack
 	undo_stack.clear();
+	ResetAutosaveJournal();
 	redo_stack.clear();
 	autosaved_commit_id = saved_commit_id = commit_id + 1;
 	context->ass->Commit("", AssFile::COMMIT_NEW);
@@ -226,6 +432,7 @@ void SubsController::Save(agi::fs::path const& filename, std::string const& enco
 
 void SubsController::Close() {
 	undo_stack.clear();
+	ResetAutosaveJournal();
 	redo_stack.clear();
 	autosaved_commit_id = saved_commit_id = commit_id + 1;
 	filename.clear();
@@ -266,16 +473,15 @@ void SubsController::AutoSave() {
 
 	autosaved_commit_id = commit_id;
 	auto frame = context->frame;
-	auto subs_copy = new AssFile(*context->ass);
-	autosave_queue->Async([subs_copy, name, directory, frame] {
+	auto journal = autosave_journal;
+	// The top of the undo stack is always the current state of the file, and
+	// copying it doesn't copy any of the file's contents
+	auto snapshot = undo_stack.back().Snapshot(context->ass.get());
+	autosave_queue->Async([journal, snapshot, name, directory, frame] {
 		wxString msg;
-		std::unique_ptr<AssFile> subs(subs_copy);
 
 		try {
-			agi::fs::CreateDirectory(directory);
-			auto path = directory /  agi::format("%s.%s.AUTOSAVE.ass", name.string(),
-			                                     agi::util::strftime("%Y-%m-%d-%H-%M-%S"));
-			SubtitleFormat::GetWriter(path)->WriteFile(subs.get(), path, 0);
+			auto path = journal->Save(snapshot, directory, name);
 			msg = fmt_tl("File backup saved as \"%s\".", path);
 		}
 		catch (const agi::Exception& err) {
@@ -300,6 +506,12 @@ bool SubsController::CanSave() const {
 	}
 }
 
+void SubsController::ResetAutosaveJournal() {
+	// Any autosaves already queued still use the old journal, and the next
+	// autosave of the new file starts with a fresh checkpoint
+	autosave_journal = std::make_shared<AutosaveJournal>();
+}
+
 void SubsController::SetFileName(agi::fs::path const& path) {
 	filename = path;
 	context->path->SetToken("?script", path.parent_path());
@@ -313,20 +525,15 @@ void SubsController::OnCommit(AssFileCommit c) {
 	commit_id = next_commit_id++;
 	// Allow coalescing only if it's the last change and the file has not been
 	// saved since the last change
+	bool replace_last = false;
 	if (commit_id == *c.commit_id+1 && redo_stack.empty() && saved_commit_id+1 != commit_id) {
 		// If only one line changed just modify it instead of copying the file
-		if (c.single_line && c.single_line->Group() == AssEntryGroup::DIALOGUE) {
-			for (auto& diag : undo_stack.back().events) {
-				if (diag.Id == c.single_line->Id) {
-					diag = *c.single_line;
-					break;
-				}
-			}
+		if (c.single_line && c.single_line->Group() == AssEntryGroup::DIALOGUE && undo_stack.back().ReplaceLine(*c.single_line)) {
 			*c.commit_id = commit_id;
 			return;
 		}
 
-		undo_stack.pop_back();
+		replace_last = true;
 	}
 
 	// Make sure the file has at least one style and one dialogue line
@@ -339,7 +546,11 @@ void SubsController::OnCommit(AssFileCommit c) {
 
 	redo_stack.clear();
 
-	undo_stack.emplace_back(context, c.message, commit_id);
+	// The previous version is only replaced after the new one has been made
+	// so that the new one can share its data
+	undo_stack.emplace_back(context, c.message, commit_id, undo_stack.empty() ? nullptr : &undo_stack.back(), c.single_line);
+	if (replace_last)
+		undo_stack.erase(std::prev(undo_stack.end(), 2));
 
 	int depth = std::max<int>(OPT_GET("Limits/Undo Levels")->GetInt(), 2);
 	while ((int)undo_stack.size() > depth)
@@ -21,6 +21,7 @@
 #include <boost/filesystem/path.hpp>
 #include <wx/timer.h>
 
+class AutosaveJournal;
 class SelectionController;
 namespace agi {
 	namespace dispatch {
@@ -59,6 +60,10 @@ class SubsController {
 	/// Queue which autosaves are performed on
 	std::unique_ptr<agi::dispatch::Queue> autosave_queue;
 
+	/// Checkpoint and journal that autosaves of the current file are written
+	/// to; only used on autosave_queue
+	std::shared_ptr<AutosaveJournal> autosave_journal;
+
 	/// A new file has been opened (filename)
 	agi::signal::Signal<agi::fs::path> FileOpen;
 	/// The file has been saved
@@ -73,6 +78,9 @@ class SubsController {
 	/// Autosave the file if there have been any chances since the last autosave
 	void AutoSave();
 
+	/// Start a new autosave checkpoint for a newly opened file
+	void ResetAutosaveJournal();
+
 	void OnCommit(AssFileCommit c);
 	void OnActiveLineChanged();
 	void OnSelectionChanged();
@@ -94,6 +102,10 @@ public:
 	/// Does the file have unsaved changes?
 	bool IsModified() const { return commit_id != saved_commit_id; };
 
+	/// Id of the current version of the file, which changes with every
+	/// commit and is restored by undo and redo
+	int CommitId() const { return commit_id; }
+
 	/// @brief Load from a file
 	/// @param file File name
 	/// @param charset Character set of file
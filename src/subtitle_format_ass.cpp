@@ -24,22 +24,151 @@
 #include "ass_parser.h"
 #include "options.h"
 #include "string_codec.h"
-#include "text_file_reader.h"
 #include "text_file_writer.h"
 #include "version.h"
 
 #include <libaegisub/ass/uuencode.h>
+#include <libaegisub/charset_conv.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/file_mapping.h>
 #include <libaegisub/fs.h>
 
+#include <algorithm>
+#include <atomic>
+#include <boost/algorithm/string/predicate.hpp>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <utility>
+
 DEFINE_EXCEPTION(AssParseError, SubtitleFormatParseError);
 
+namespace {
+typedef std::pair<const char *, const char *> line_range;
+
+/// Number of lines parsed at a time by each thread when loading events
+const size_t event_chunk_size = 2048;
+
+bool is_space(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+/// Trim whitespace and byte order marks in the same way as TextFileReader
+line_range trim(const char *begin, const char *end) {
+	while (begin < end && is_space(*begin)) ++begin;
+	while (end > begin && is_space(end[-1])) --end;
+	if (end - begin >= 3 && !memcmp(begin, "\xEF\xBB\xBF", 3))
+		begin += 3;
+	return line_range(begin, end);
+}
+
+bool starts_with(line_range line, const char *prefix) {
+	size_t len = strlen(prefix);
+	return size_t(line.second - line.first) >= len && !memcmp(line.first, prefix, len);
+}
+
+/// Parses lines into AssDialogues using as many threads as are available.
+/// Shared with the background jobs, as they may not start until after all
+/// of the work is done.
+struct event_parser {
+	std::vector<line_range> const& lines;
+	std::vector<AssDialogue *> parsed;
+	std::vector<std::exception_ptr> errors;
+	const size_t chunks;
+	std::atomic<size_t> next_chunk{0};
+
+	std::mutex mutex;
+	std::condition_variable finished;
+	size_t chunks_done = 0;
+
+	event_parser(std::vector<line_range> const& lines)
+	: lines(lines)
+	, parsed(lines.size())
+	, chunks((lines.size() + event_chunk_size - 1) / event_chunk_size)
+	{
+		errors.resize(chunks);
+	}
+
+	void Run() {
+		for (size_t chunk; (chunk = next_chunk++) < chunks; ) {
+			const size_t end = std::min(lines.size(), (chunk + 1) * event_chunk_size);
+			try {
+				for (size_t i = chunk * event_chunk_size; i < end; ++i)
+					parsed[i] = new AssDialogue(std::string(lines[i].first, lines[i].second));
+			}
+			catch (...) {
+				errors[chunk] = std::current_exception();
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (++chunks_done == chunks)
+				finished.notify_all();
+		}
+	}
+};
+
+void parse_events(AssFile *target, std::vector<line_range> const& lines) {
+	auto parser = std::make_shared<event_parser>(lines);
+
+	// The calling thread works through the chunks as well, so this finishes
+	// even if every background thread is busy
+	const size_t threads = std::min<size_t>(parser->chunks, std::thread::hardware_concurrency());
+	for (size_t i = 1; i < threads; ++i)
+		agi::dispatch::Background().Async([=] { parser->Run(); });
+	parser->Run();
+
+	std::unique_lock<std::mutex> lock(parser->mutex);
+	parser->finished.wait(lock, [&] { return parser->chunks_done == parser->chunks; });
+
+	for (auto const& error : parser->errors) {
+		if (!error) continue;
+		for (auto line : parser->parsed)
+			delete line;
+		std::rethrow_exception(error);
+	}
+
+	for (auto line : parser->parsed)
+		target->Events.push_back(*line);
+}
+}
+
 void AssSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename, agi::vfr::Framerate const& fps, std::string const& encoding) const {
 	int version = !agi::fs::HasExtension(filename, "ssa");
 
-	TextFileReader file(filename, encoding);
+	agi::read_file_mapping file(filename);
+	const char *begin = file.read();
+	const char *end = begin + file.size();
+
+	// Convert the whole file at once rather than a line at a time
+	std::string converted;
+	if (!boost::iequals(encoding, "utf-8")) {
+		agi::charset::IconvWrapper conv(encoding.c_str(), "utf-8");
+		conv.Convert(begin, file.size(), converted);
+		begin = converted.data();
+		end = begin + converted.size();
+	}
+
+	// Everything other than events goes through the parser in order, while
+	// events are collected to be parsed in parallel at the end
 	AssParser parser(target, version);
-	while (file.HasMoreLines())
-		parser.AddLine(file.ReadLineFromFile());
+	std::vector<line_range> events;
+	while (begin < end) {
+		auto line_end = static_cast<const char *>(memchr(begin, '\n', end - begin));
+		if (!line_end) line_end = end;
+		auto line = trim(begin, line_end);
+		begin = line_end + 1;
+
+		if (parser.InEventsSection() && (starts_with(line, "Dialogue:") || starts_with(line, "Comment:")))
+			events.push_back(line);
+		else
+			parser.AddLine(std::string(line.first, line.second));
+	}
+	// Finish any attachment which runs to the end of the file
+	parser.AddLine("");
+
+	parse_events(target, events);
 }
 
 #ifdef _WIN32
@@ -57,12 +186,27 @@ const char *format(AssEntryGroup group) {
 	return nullptr;
 }
 
+/// Line output which writes UTF-8 to a stream, with the same interface as TextFileWriter
+struct StreamWriter {
+	std::ostream& out;
+
+	StreamWriter(std::ostream& out) : out(out) { }
+
+	void WriteLineToFile(std::string const& line, bool addLineBreak=true) {
+		out << line;
+		if (addLineBreak)
+			out << '\n';
+	}
+};
+
+template<typename Output>
 struct Writer {
-	TextFileWriter file;
+	Output file;
 	AssEntryGroup group = AssEntryGroup::INFO;
 
-	Writer(agi::fs::path const& filename, std::string const& encoding)
-	: file(filename, encoding)
+	template<typename... Args>
+	Writer(Args&&... args)
+	: file(std::forward<Args>(args)...)
 	{
 		file.WriteLineToFile("[Script Info]");
 		file.WriteLineToFile(std::string("; Script generated by Aegisub ") + GetAegisubLongVersionString());
@@ -152,19 +296,29 @@ struct Writer {
 }
 
 void AssSubtitleFormat::WriteFile(const AssFile *src, agi::fs::path const& filename, agi::vfr::Framerate const& fps, std::string const& encoding) const {
-	Writer writer(filename, encoding);
+	Writer<TextFileWriter> writer(filename, encoding);
 	writer.Write(src->Info);
 	writer.Write(src->Properties);
 	writer.Write(src->Styles);
 	writer.Write(src->Attachments);
 	writer.Write(src->Events);
 	writer.WriteExtradata(src->Extradata);
+	writer.file.Flush();
 }
 
 void AssSubtitleFormat::ExportFile(const AssFile *src, agi::fs::path const& filename, agi::vfr::Framerate const& fps, std::string const& encoding) const {
-	Writer writer(filename, encoding);
+	Writer<TextFileWriter> writer(filename, encoding);
 	writer.Write(src->Info);
 	writer.Write(src->Styles);
 	writer.Write(src->Attachments);
 	writer.Write(src->Events);
+	writer.file.Flush();
+}
+
+void AssSubtitleFormat::WriteMetadata(const AssFile *src, std::ostream& out) {
+	Writer<StreamWriter> writer(out);
+	writer.Write(src->Info);
+	writer.Write(src->Properties);
+	writer.Write(src->Styles);
+	writer.WriteExtradata(src->Extradata);
 }
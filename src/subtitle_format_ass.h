@@ -31,4 +31,8 @@ public:
 
 	// Does not write [Aegisub Project Garbage] and [Aegisub Extradata] sections when exporting
 	void ExportFile(const AssFile *src, agi::fs::path const& filename, agi::vfr::Framerate const& fps, std::string const& encoding) const override;
+
+	/// Write everything but the attachments and events of src to out as
+	/// UTF-8, in a form which AssParser can read back
+	static void WriteMetadata(const AssFile *src, std::ostream& out);
 };
@@ -145,4 +145,5 @@ void MicroDVDSubtitleFormat::WriteFile(const AssFile *src, agi::fs::path const&
 
 		file.WriteLineToFile(agi::format("{%i}{%i}%s", start, end, boost::replace_all_copy(current.Text.get(), "\\N", "|")));
 	}
+	file.Flush();
 }
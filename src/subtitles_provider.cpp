@@ -99,9 +99,12 @@ void SubtitlesProvider::LoadSubtitles(AssFile *subs, int time) {
 	}
 
 	push_header("[Events]\n");
+	std::string data;
 	for (auto const& line : subs->Events) {
-		if (!line.Comment && (time < 0 || !(line.Start > time || line.End <= time)))
-			push_line(line.GetEntryData());
+		if (!line.Comment && (time < 0 || !(line.Start > time || line.End <= time))) {
+			line.GetEntryData(data);
+			push_line(data);
+		}
 	}
 
 	LoadSubtitles(&buffer[0], buffer.size());
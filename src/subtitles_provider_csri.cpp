@@ -91,12 +91,12 @@ void CSRISubtitlesProvider::DrawSubtitles(VideoFrame &dst, double time) {
 
 	csri_frame frame;
 	if (dst.flipped) {
-		frame.planes[0] = dst.data.data() + (dst.height-1) * dst.width * 4;
-		frame.strides[0] = -(ptrdiff_t)dst.width * 4;
+		frame.planes[0] = dst.MutableData() + (dst.height-1) * dst.pitch;
+		frame.strides[0] = -(ptrdiff_t)dst.pitch;
 	}
 	else {
-		frame.planes[0] = dst.data.data();
-		frame.strides[0] = dst.width * 4;
+		frame.planes[0] = dst.MutableData();
+		frame.strides[0] = dst.pitch;
 	}
 	frame.pixfmt = CSRI_F_BGR_;
 
@@ -34,10 +34,17 @@
 
 #include "subtitles_provider_libass.h"
 
+#include "ass_attachment.h"
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "ass_info.h"
+#include "ass_style.h"
 #include "compat.h"
 #include "include/aegisub/subtitles_provider.h"
 #include "video_frame.h"
 
+#include <libaegisub/alpha_blend.h>
+#include <libaegisub/ass/uuencode.h>
 #include <libaegisub/background_runner.h>
 #include <libaegisub/dispatch.h>
 #include <libaegisub/exception.h>
@@ -46,13 +53,10 @@
 #include <libaegisub/util.h>
 
 #include <atomic>
-#if BOOST_VERSION >= 106900
-#include <boost/gil.hpp>
-#else
-#include <boost/gil/gil_all.hpp>
-#endif
 #include <memory>
 #include <mutex>
+#include <set>
+#include <unordered_map>
 
 #include <wx/intl.h>
 #include <wx/thread.h>
@@ -80,6 +84,11 @@ void msg_callback(int level, const char *fmt, va_list args, void *) {
 		LOG_D("subtitle/provider/libass") << buf;
 }
 
+// Embedded fonts which have been added to the library, by name and hash of the
+// data, as libass has no way to remove them again
+std::mutex font_mutex;
+std::set<std::pair<std::string, size_t>> loaded_fonts;
+
 // Stuff used on the cache thread, owned by a shared_ptr in case the provider
 // gets deleted before the cache finishing updating
 struct cache_thread_shared {
@@ -93,6 +102,23 @@ class LibassSubtitlesProvider final : public SubtitlesProvider {
 	std::shared_ptr<cache_thread_shared> shared;
 	ASS_Track* ass_track = nullptr;
 
+	/// Script Info and Styles sections which ass_track was created from
+	std::string header;
+	/// Font attachments of the last loaded file, to skip checking them again
+	/// when they haven't changed
+	std::vector<std::pair<const std::string *, size_t>> fonts;
+	/// Entry data of each event in ass_track
+	std::vector<std::string> event_data;
+	/// Index in ass_track of the event for each line of the file, or -1 for
+	/// commented lines
+	std::vector<int> row_events;
+
+	void LoadFonts(AssFile *subs);
+	/// Parse a line and append it to ass_track
+	void AddEvent(std::string const& data, int row);
+	/// Remove an event, filling the gap with the last event
+	void RemoveEvent(int eid);
+
 	ASS_Renderer *renderer() {
 		if (shared->ready)
 			return shared->renderer;
@@ -127,8 +153,14 @@ public:
 		if (ass_track) ass_free_track(ass_track);
 		ass_track = ass_read_memory(library, const_cast<char *>(data), len, nullptr);
 		if (!ass_track) throw agi::InternalError("libass failed to load subtitles.");
+		header.clear();
+		event_data.clear();
+		row_events.clear();
 	}
 
+	void LoadSubtitles(AssFile *subs, int time) override;
+	bool UpdateLine(AssDialogue const& line) override;
+
 	void DrawSubtitles(VideoFrame &dst, double time) override;
 
 	void Reinitialize() override {
@@ -163,10 +195,133 @@ LibassSubtitlesProvider::~LibassSubtitlesProvider() {
 	if (ass_track) ass_free_track(ass_track);
 }
 
-#define _r(c) ((c)>>24)
-#define _g(c) (((c)>>16)&0xFF)
-#define _b(c) (((c)>>8)&0xFF)
-#define _a(c) ((c)&0xFF)
+void LibassSubtitlesProvider::LoadFonts(AssFile *subs) {
+	// Attachment data is a flyweight, so unchanged attachments will still
+	// have their data at the same address
+	std::vector<std::pair<const std::string *, size_t>> new_fonts;
+	for (auto const& attachment : subs->Attachments) {
+		if (attachment.Group() == AssEntryGroup::FONT)
+			new_fonts.emplace_back(&attachment.GetEntryData(), attachment.GetEntryData().size());
+	}
+	if (new_fonts == fonts) return;
+
+	std::lock_guard<std::mutex> lock(font_mutex);
+	for (auto const& attachment : subs->Attachments) {
+		if (attachment.Group() != AssEntryGroup::FONT) continue;
+
+		auto const& data = attachment.GetEntryData();
+		auto name = attachment.GetFileName(true);
+		if (!loaded_fonts.emplace(name, std::hash<std::string>()(data)).second) continue;
+
+		auto header_end = data.find('\n');
+		auto decoded = agi::ass::UUDecode(data.c_str() + header_end + 1, data.c_str() + data.size());
+		ass_add_font(library, const_cast<char *>(name.c_str()), decoded.data(), decoded.size());
+	}
+	fonts = std::move(new_fonts);
+}
+
+void LibassSubtitlesProvider::AddEvent(std::string const& data, int row) {
+	std::string line = data;
+	ass_process_data(ass_track, &line[0], line.size());
+
+	// libass silently drops lines which it fails to parse
+	if ((size_t)ass_track->n_events == event_data.size()) return;
+	ass_track->events[ass_track->n_events - 1].ReadOrder = row;
+	event_data.push_back(data);
+	row_events[row] = ass_track->n_events - 1;
+}
+
+void LibassSubtitlesProvider::RemoveEvent(int eid) {
+	ass_free_event(ass_track, eid);
+	int last = --ass_track->n_events;
+	if (eid != last) {
+		ass_track->events[eid] = ass_track->events[last];
+		event_data[eid] = std::move(event_data[last]);
+		row_events[ass_track->events[eid].ReadOrder] = eid;
+	}
+	event_data.pop_back();
+}
+
+void LibassSubtitlesProvider::LoadSubtitles(AssFile *subs, int) {
+	// Loading everything only costs parsing the lines which have changed, so
+	// there's no point in limiting it to the lines visible at a given time
+	LoadFonts(subs);
+
+	std::string new_header = "[Script Info]\n";
+	for (auto const& line : subs->Info)
+		new_header += line.GetEntryData() + "\n";
+	new_header += "[V4+ Styles]\n";
+	for (auto const& line : subs->Styles)
+		new_header += line.GetEntryData() + "\n";
+	new_header += "[Events]\nFormat: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n";
+
+	// Events refer to styles by index, so everything has to be reparsed if
+	// the styles change
+	if (!ass_track || header.empty() || new_header != header) {
+		if (ass_track) ass_free_track(ass_track);
+		ass_track = ass_new_track(library);
+		if (!ass_track) throw agi::InternalError("libass failed to load subtitles.");
+		ass_process_codec_private(ass_track, &new_header[0], new_header.size());
+		header = std::move(new_header);
+		event_data.clear();
+	}
+
+	// Keep the events whose lines are unchanged and parse the rest
+	std::unordered_map<std::string, std::vector<int>> old_events;
+	for (size_t i = 0; i < event_data.size(); ++i)
+		old_events[std::move(event_data[i])].push_back(i);
+
+	std::vector<ASS_Event> kept;
+	std::vector<std::string> kept_data;
+	std::vector<bool> used(event_data.size());
+	std::vector<std::pair<std::string, int>> added;
+	row_events.assign(subs->Events.size(), -1);
+
+	int row = 0;
+	std::string data;
+	for (auto const& line : subs->Events) {
+		if (!line.Comment) {
+			line.GetEntryData(data);
+			auto it = old_events.find(data);
+			if (it != old_events.end() && !it->second.empty()) {
+				int eid = it->second.back();
+				it->second.pop_back();
+				used[eid] = true;
+				row_events[row] = kept.size();
+				kept.push_back(ass_track->events[eid]);
+				kept.back().ReadOrder = row;
+				kept_data.push_back(data);
+			}
+			else
+				added.emplace_back(data, row);
+		}
+		++row;
+	}
+
+	for (size_t i = 0; i < used.size(); ++i) {
+		if (!used[i])
+			ass_free_event(ass_track, i);
+	}
+	std::copy(kept.begin(), kept.end(), ass_track->events);
+	ass_track->n_events = kept.size();
+	event_data = std::move(kept_data);
+
+	for (auto const& line : added)
+		AddEvent(line.first, line.second);
+}
+
+bool LibassSubtitlesProvider::UpdateLine(AssDialogue const& line) {
+	if (!ass_track || header.empty() || line.Row < 0 || (size_t)line.Row >= row_events.size())
+		return false;
+
+	if (row_events[line.Row] >= 0) {
+		RemoveEvent(row_events[line.Row]);
+		row_events[line.Row] = -1;
+	}
+	if (!line.Comment)
+		AddEvent(line.GetEntryData(), line.Row);
+	return true;
+}
 
 void LibassSubtitlesProvider::DrawSubtitles(VideoFrame &frame,double time) {
 	ass_set_frame_size(renderer(), frame.width, frame.height);
@@ -177,31 +332,22 @@ void LibassSubtitlesProvider::DrawSubtitles(VideoFrame &frame,double time) {
 	// Here, we loop through their linked list, get the colour of the current, and blend into the frame.
 	// This is repeated for all of them.
 
-	using namespace boost::gil;
-	auto dst = interleaved_view(frame.width, frame.height, (bgra8_pixel_t*)frame.data.data(), frame.width * 4);
-	if (frame.flipped)
-		dst = flipped_up_down_view(dst);
-
+	// Frames are shared with the video cache, so only copy this one if
+	// there's actually something to draw on it
+	uint8_t *data = img ? frame.MutableData() : nullptr;
+	const ptrdiff_t stride = frame.pitch;
 	for (; img; img = img->next) {
-		unsigned int opacity = 255 - ((unsigned int)_a(img->color));
-		unsigned int r = (unsigned int)_r(img->color);
-		unsigned int g = (unsigned int)_g(img->color);
-		unsigned int b = (unsigned int)_b(img->color);
-
-		auto srcview = interleaved_view(img->w, img->h, (gray8_pixel_t*)img->bitmap, img->stride);
-		auto dstview = subimage_view(dst, img->dst_x, img->dst_y, img->w, img->h);
-
-		transform_pixels(dstview, srcview, dstview, [=](const bgra8_pixel_t frame, const gray8_pixel_t src) -> bgra8_pixel_t {
-			unsigned int k = ((unsigned)src) * opacity / 255;
-			unsigned int ck = 255 - k;
-
-			bgra8_pixel_t ret;
-			ret[0] = (k * b + ck * frame[0]) / 255;
-			ret[1] = (k * g + ck * frame[1]) / 255;
-			ret[2] = (k * r + ck * frame[2]) / 255;
-			ret[3] = 0;
-			return ret;
-		});
+		uint8_t *dst = data;
+		ptrdiff_t dst_stride = stride;
+		if (frame.flipped) {
+			dst += (frame.height - 1 - img->dst_y) * stride;
+			dst_stride = -stride;
+		}
+		else
+			dst += img->dst_y * stride;
+		dst += img->dst_x * 4;
+
+		agi::BlendMask(dst, dst_stride, img->bitmap, img->stride, img->w, img->h, img->color);
 	}
 }
 }
@@ -30,29 +30,39 @@
 
 #include <boost/algorithm/string/case_conv.hpp>
 
+namespace {
+/// Buffered text is converted once there's at least this much of it
+const size_t flush_size = 65536;
+}
+
 TextFileWriter::TextFileWriter(agi::fs::path const& filename, std::string encoding)
 : file(new agi::io::Save(filename, true))
 {
 	if (encoding.empty())
 		encoding = OPT_GET("App/Save Charset")->GetString();
-	if (encoding != "utf-8" && encoding != "UTF-8") {
+	if (encoding != "utf-8" && encoding != "UTF-8")
 		conv = agi::make_unique<agi::charset::IconvWrapper>("utf-8", encoding.c_str(), true);
-		newline = conv->Convert(newline);
-	}
 
 	try {
 		// Write the BOM
 		WriteLineToFile("\xEF\xBB\xBF", false);
+		Flush();
 	}
 	catch (agi::charset::ConversionFailure&) {
 		// If the BOM could not be converted to the target encoding it isn't needed
+		buffer.clear();
 	}
 }
 
 TextFileWriter::~TextFileWriter() {
 	try {
+		Flush();
 		file->Close();
 	}
+	catch (agi::charset::ConversionFailure const& e) {
+		// Only reached if the owner didn't call Flush()
+		wxMessageBox(wxString::FromUTF8(e.GetMessage().c_str()), "Exception in TextFileWriter", wxOK | wxCENTRE | wxICON_ERROR);
+	}
 	catch (agi::fs::FileSystemError const&e) {
 #if wxCHECK_VERSION (3, 1, 0)
 		wxString m = wxString::FromUTF8(e.GetMessage());
@@ -67,13 +77,34 @@ TextFileWriter::~TextFileWriter() {
 }
 
 void TextFileWriter::WriteLineToFile(std::string const& line, bool addLineBreak) {
-	if (conv) {
-		auto converted = conv->Convert(line);
-		file->Get().write(converted.data(), converted.size());
-	}
-	else
+	if (!conv) {
 		file->Get().write(line.data(), line.size());
+		if (addLineBreak)
+			file->Get().write(newline.data(), newline.size());
+		return;
+	}
 
+	// Converting a line at a time spends most of its time on per-call
+	// overhead, so lines are collected and converted in large blocks
+	buffer += line;
 	if (addLineBreak)
-		file->Get().write(newline.data(), newline.size());
+		buffer += newline;
+	if (buffer.size() >= flush_size)
+		Flush();
+}
+
+void TextFileWriter::Flush() {
+	if (!conv || buffer.empty()) return;
+
+	// Empty the buffer even if the conversion fails so that the failure
+	// isn't reported a second time by the destructor
+	std::string pending;
+	pending.swap(buffer);
+
+	converted.clear();
+	conv->Convert(pending, converted);
+	file->Get().write(converted.data(), converted.size());
+
+	pending.clear();
+	buffer.swap(pending);
 }
@@ -32,6 +32,11 @@ namespace agi {
 class TextFileWriter {
 	std::unique_ptr<agi::io::Save> file;
 	std::unique_ptr<agi::charset::IconvWrapper> conv;
+	/// UTF-8 lines waiting to be converted to the output encoding
+	std::string buffer;
+	/// Scratch space for the converted buffer
+	std::string converted;
+	/// Newline in UTF-8; converted along with the lines when conv is set
 #ifdef _WIN32
 	std::string newline = "\r\n";
 #else
@@ -43,4 +48,10 @@ public:
 	~TextFileWriter();
 
 	void WriteLineToFile(std::string const& line, bool addLineBreak=true);
+
+	/// @brief Convert and write any buffered lines
+	///
+	/// Must be called after the last line is written, as conversion errors
+	/// can't be reported to the caller from the destructor.
+	void Flush();
 };
@@ -16,6 +16,11 @@
 
 #include "video_frame.h"
 
+#include <cstring>
+#include <mutex>
+#include <utility>
+#include <vector>
+
 #if BOOST_VERSION >= 106900
 #include <boost/gil.hpp>
 #else
@@ -24,6 +29,50 @@
 #include <wx/image.h>
 
 namespace {
+	/// Recycles frame buffers, as allocating a new multi-megabyte buffer for
+	/// every frame means page faulting all of it in again
+	class buffer_pool {
+		/// Maximum number of unused buffers to hold on to
+		static const size_t max_free = 4;
+
+		std::mutex mutex;
+		/// Unused buffers and their sizes, oldest first
+		std::vector<std::pair<size_t, unsigned char *>> free_buffers;
+
+		void Release(unsigned char *buffer, size_t size) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (free_buffers.size() == max_free) {
+				delete[] free_buffers.front().second;
+				free_buffers.erase(free_buffers.begin());
+			}
+			free_buffers.emplace_back(size, buffer);
+		}
+
+	public:
+		std::shared_ptr<unsigned char> Get(size_t size) {
+			unsigned char *buffer = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				for (auto it = free_buffers.rbegin(); it != free_buffers.rend(); ++it) {
+					if (it->first == size) {
+						buffer = it->second;
+						free_buffers.erase(std::next(it).base());
+						break;
+					}
+				}
+			}
+			if (!buffer)
+				buffer = new unsigned char[size];
+			return std::shared_ptr<unsigned char>(buffer, [=](unsigned char *buf) { Release(buf, size); });
+		}
+	};
+
+	// Deliberately never destroyed, as frames may outlive static destruction
+	buffer_pool& pool() {
+		static buffer_pool *pool = new buffer_pool;
+		return *pool;
+	}
+
 	// We actually have bgr_, not bgra, so we need a custom converter which ignores the alpha channel
 	struct color_converter {
 		template <typename P1, typename P2>
@@ -37,11 +86,31 @@ namespace {
 	};
 }
 
+unsigned char *VideoFrame::Allocate(size_t width, size_t height, size_t pitch) {
+	// Release the old buffer first so that it can be reused for the new one
+	data.reset();
+	data = pool().Get(pitch * height);
+	this->width = width;
+	this->height = height;
+	this->pitch = pitch;
+	flipped = false;
+	return data.get();
+}
+
+unsigned char *VideoFrame::MutableData() {
+	if (data && data.use_count() > 1) {
+		auto copy = pool().Get(Size());
+		memcpy(copy.get(), data.get(), Size());
+		data = std::move(copy);
+	}
+	return data.get();
+}
+
 wxImage GetImage(VideoFrame const& frame) {
 	using namespace boost::gil;
 
 	wxImage img(frame.width, frame.height);
-	auto src = interleaved_view(frame.width, frame.height, (bgra8_pixel_t*)frame.data.data(), frame.pitch);
+	auto src = interleaved_view(frame.width, frame.height, (bgra8_pixel_t*)frame.data.get(), frame.pitch);
 	auto dst = interleaved_view(frame.width, frame.height, (rgb8_pixel_t*)img.GetData(), 3 * frame.width);
 	if (frame.flipped)
 		src = flipped_up_down_view(src);
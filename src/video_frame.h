@@ -14,16 +14,36 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
-#include <vector>
+#include <cstddef>
+#include <memory>
 
 class wxImage;
 
+/// A decoded video frame in BGRA order
+///
+/// Copying a frame is cheap, as the copies share their pixel data. Frames must
+/// therefore be written to only through Allocate() or MutableData().
 struct VideoFrame {
-	std::vector<unsigned char> data;
-	size_t width;
-	size_t height;
-	size_t pitch;
-	bool flipped;
+	/// Pixel data, which goes back to a pool to be reused once no frames
+	/// refer to it
+	std::shared_ptr<unsigned char> data;
+	size_t width = 0;
+	size_t height = 0;
+	/// Distance in bytes between the starts of rows
+	size_t pitch = 0;
+	/// Are the rows stored bottom to top?
+	bool flipped = false;
+
+	/// Replace the pixel data with an uninitialized buffer of pitch * height bytes
+	/// @return The new buffer
+	unsigned char *Allocate(size_t width, size_t height, size_t pitch);
+
+	/// Get the pixel data for writing, first making a copy of it if it is
+	/// shared with any other frames
+	unsigned char *MutableData();
+
+	/// Size in bytes of the pixel data
+	size_t Size() const { return data ? pitch * height : 0; }
 };
 
 wxImage GetImage(VideoFrame const& frame);
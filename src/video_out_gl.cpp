@@ -56,7 +56,8 @@ BOOST_NOINLINE void throw_error(GLenum err, const char *msg) {
 /// @brief Structure tracking all precomputable information about a subtexture
 struct VideoOutGL::TextureInfo {
 	GLuint textureID = 0;
-	int dataOffset = 0;
+	int sourceX = 0;
+	int sourceY = 0;
 	int sourceH = 0;
 	int sourceW = 0;
 };
@@ -186,15 +187,11 @@ void VideoOutGL::InitTextures(int width, int height, GLenum format, int bpp, boo
 			TextureInfo& ti = textureList[row * textureCols + col];
 
 			// Width and height of the area read from the frame data
-			int sourceX = col * textureArea;
-			int sourceY = row * textureArea;
+			int sourceX = ti.sourceX = col * textureArea;
+			int sourceY = ti.sourceY = row * textureArea;
 			ti.sourceW  = std::min(frameWidth  - sourceX, maxTextureSize);
 			ti.sourceH  = std::min(frameHeight - sourceY, maxTextureSize);
 
-			// Used instead of GL_PACK_SKIP_ROWS/GL_PACK_SKIP_PIXELS due to
-			// performance issues with the emulation
-			ti.dataOffset = sourceY * frameWidth * bpp + sourceX * bpp;
-
 			int textureHeight = SmallestPowerOf2(ti.sourceH);
 			int textureWidth  = SmallestPowerOf2(ti.sourceW);
 			if (!supportsRectangularTextures) {
@@ -261,7 +258,7 @@ void VideoOutGL::UploadFrameData(VideoFrame const& frame) {
 	for (auto& ti : textureList) {
 		CHECK_ERROR(glBindTexture(GL_TEXTURE_2D, ti.textureID));
 		CHECK_ERROR(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ti.sourceW,
-			ti.sourceH, GL_BGRA_EXT, GL_UNSIGNED_BYTE, &frame.data[ti.dataOffset]));
+			ti.sourceH, GL_BGRA_EXT, GL_UNSIGNED_BYTE, frame.data.get() + ti.sourceY * frame.pitch + ti.sourceX * 4));
 	}
 
 	CHECK_ERROR(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
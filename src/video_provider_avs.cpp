@@ -41,6 +41,7 @@
 #include <libaegisub/make_unique.h>
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <cstring>
 #include <mutex>
 
 #ifdef _WIN32
@@ -313,11 +314,9 @@ void AvisynthVideoProvider::GetFrame(int n, VideoFrame &out) {
 
 	auto frame = RGB32Video->GetFrame(n, avs.GetEnv());
 	auto ptr = frame->GetReadPtr();
-	out.data.assign(ptr, ptr + frame->GetPitch() * frame->GetHeight());
+	auto dst = out.Allocate(frame->GetRowSize() / 4, frame->GetHeight(), frame->GetPitch());
+	memcpy(dst, ptr, frame->GetPitch() * frame->GetHeight());
 	out.flipped = true;
-	out.height = frame->GetHeight();
-	out.width = frame->GetRowSize() / 4;
-	out.pitch = frame->GetPitch();
 }
 }
 
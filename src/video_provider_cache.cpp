@@ -19,9 +19,12 @@
 #include "options.h"
 #include "video_frame.h"
 
+#include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
 
+#include <atomic>
 #include <list>
+#include <unordered_map>
 
 namespace {
 /// A video frame and its frame number
@@ -43,20 +46,40 @@ class VideoProviderCache final : public VideoProvider {
 
 	/// @brief Maximum size of the cache in bytes
 	///
-	/// Note that this is a soft limit. The cache stops allocating new frames
-	/// once it has exceeded the limit, but it never tries to shrink
-	const size_t max_cache_size = OPT_GET("Provider/Video/Cache/Size")->GetInt() << 20; // convert MB to bytes
+	/// Frames are evicted before a new one is added if adding it would go
+	/// over this. Changes to the option take effect on the next request.
+	std::atomic<size_t> max_cache_size{(size_t)OPT_GET("Provider/Video/Cache/Size")->GetInt() << 20}; // convert MB to bytes
 
 	/// Cache of video frames with the most recently used ones at the front
 	std::list<CachedFrame> cache;
 
+	/// Position in the cache of each cached frame
+	std::unordered_map<int, std::list<CachedFrame>::iterator> index;
+
+	/// Total size in bytes of the frames in the cache
+	size_t cache_size = 0;
+
+	/// Usage statistics, logged when the cache is destroyed
+	size_t hits = 0;
+	size_t misses = 0;
+	size_t evictions = 0;
+	size_t peak_size = 0;
+
+	agi::signal::Connection size_connection;
+
+	/// Evict frames until the cache is no larger than max_size
+	void Shrink(size_t max_size);
+
 public:
-	VideoProviderCache(std::unique_ptr<VideoProvider> master) : master(std::move(master)) { }
+	VideoProviderCache(std::unique_ptr<VideoProvider> master);
+	~VideoProviderCache();
 
 	void GetFrame(int n, VideoFrame &frame) override;
 
 	void SetColorSpace(std::string const& m) override {
 		cache.clear();
+		index.clear();
+		cache_size = 0;
 		return master->SetColorSpace(m);
 	}
 
@@ -72,30 +95,74 @@ public:
 	std::string GetRealColorSpace() const override { return master->GetRealColorSpace(); }
 	bool ShouldSetVideoProperties() const override { return master->ShouldSetVideoProperties(); }
 	bool HasAudio() const override                 { return master->HasAudio(); }
+	bool WantsCaching() const override             { return master->WantsCaching(); }
 };
 
-void VideoProviderCache::GetFrame(int n, VideoFrame &out) {
-	size_t total_size = 0;
+VideoProviderCache::VideoProviderCache(std::unique_ptr<VideoProvider> master)
+: master(std::move(master))
+, size_connection(OPT_SUB("Provider/Video/Cache/Size", [=](agi::OptionValue const& opt) {
+	max_cache_size = (size_t)opt.GetInt() << 20;
+}))
+{
+}
 
-	for (auto cur = cache.begin(); cur != cache.end(); ++cur) {
-		if (cur->frame_number == n) {
-			cache.splice(cache.begin(), cache, cur); // Move to front
-			out = cache.front().frame;
-			return;
-		}
+VideoProviderCache::~VideoProviderCache() {
+	LOG_I("video/cache") << "Frame cache: " << hits << " hits, " << misses
+		<< " misses, " << evictions << " evictions, peak size "
+		<< (peak_size >> 20) << " MB of " << (max_cache_size >> 20) << " MB";
+}
+
+void VideoProviderCache::Shrink(size_t max_size) {
+	while (cache_size > max_size && !cache.empty()) {
+		cache_size -= cache.back().frame.Size();
+		index.erase(cache.back().frame_number);
+		cache.pop_back();
+		++evictions;
+	}
+}
 
-		total_size += cur->frame.data.size();
+void VideoProviderCache::GetFrame(int n, VideoFrame &out) {
+	auto it = index.find(n);
+	if (it != index.end()) {
+		++hits;
+		cache.splice(cache.begin(), cache, it->second); // Move to front
+		out = cache.front().frame;
+		return;
 	}
 
+	++misses;
 	master->GetFrame(n, out);
 
-	if (total_size >= max_cache_size) {
-		cache.splice(cache.begin(), cache, --cache.end()); // Move last to front
-		cache.front().frame_number = n;
-		cache.front().frame = out;
+	const size_t max_size = max_cache_size;
+	const size_t frame_size = out.Size();
+	if (frame_size > max_size) {
+		Shrink(max_size);
+		return;
+	}
+
+	// Make room for the new frame, reusing the list node of the last frame
+	// evicted if there was one. The cached frame shares its pixel data with
+	// out, and evicted frames' data goes back to the frame buffer pool.
+	std::list<CachedFrame> evicted;
+	while (cache_size + frame_size > max_size) {
+		auto last = std::prev(cache.end());
+		cache_size -= last->frame.Size();
+		index.erase(last->frame_number);
+		evicted.clear();
+		evicted.splice(evicted.begin(), cache, last);
+		++evictions;
 	}
-	else
+
+	if (evicted.empty())
 		cache.emplace_front(out, n);
+	else {
+		cache.splice(cache.begin(), evicted);
+		cache.front().frame = out;
+		cache.front().frame_number = n;
+	}
+	index[n] = cache.begin();
+	cache_size += frame_size;
+	peak_size = std::max(peak_size, cache_size);
 }
 }
 
@@ -57,14 +57,14 @@ DummyVideoProvider::DummyVideoProvider(double fps, int frames, int width, int he
 , width(width)
 , height(height)
 {
-	data.resize(width * height * 4);
+	data.reset(new unsigned char[width * height * 4], std::default_delete<unsigned char[]>());
 
 	auto red = colour.r;
 	auto green = colour.g;
 	auto blue = colour.b;
 
 	using namespace boost::gil;
-	auto dst = interleaved_view(width, height, (bgra8_pixel_t*)data.data(), 4 * width);
+	auto dst = interleaved_view(width, height, (bgra8_pixel_t*)data.get(), 4 * width);
 
 	bgra8_pixel_t colors[2] = {
 		bgra8_pixel_t(blue, green, red, 0),
@@ -34,6 +34,8 @@
 
 #include "include/aegisub/video_provider.h"
 
+#include <memory>
+
 namespace agi { struct Color; }
 
 /// @class DummyVideoProvider
@@ -47,8 +49,8 @@ class DummyVideoProvider final : public VideoProvider {
 	int width;               ///< Width in pixels
 	int height;              ///< Height in pixels
 
-	/// The data for the image returned for all frames
-	std::vector<unsigned char> data;
+	/// The data for the image returned for all frames, shared by all of them
+	std::shared_ptr<unsigned char> data;
 
 public:
 	/// Create a dummy video from separate parameters
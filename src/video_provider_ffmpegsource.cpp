@@ -43,6 +43,9 @@
 #include <libaegisub/fs.h>
 #include <libaegisub/make_unique.h>
 
+#include <algorithm>
+#include <cstring>
+
 namespace {
 typedef enum AGI_ColorSpaces {
 	AGI_CS_RGB = 0,
@@ -61,6 +64,32 @@ typedef enum AGI_ColorSpaces {
 	AGI_CS_ICTCP = 14
 } AGI_ColorSpaces;
 
+/// Copy a frame, reversing the order of the pixels in each row
+void copy_mirrored(unsigned char *dst, const unsigned char *src, size_t src_pitch, int width, int height) {
+	for (int y = 0; y < height; ++y) {
+		auto row = reinterpret_cast<const uint32_t *>(src + y * src_pitch);
+		std::reverse_copy(row, row + width, reinterpret_cast<uint32_t *>(dst) + y * width);
+	}
+}
+
+/// Copy a frame, writing each column of it as a row of dst
+/// @param reverse Read each column from the bottom up rather than top down
+void copy_transposed(unsigned char *dst, const unsigned char *src, size_t src_pitch, int width, int height, bool reverse) {
+	// Work in square tiles so that both the reads and the writes stay in cache
+	const int tile = 32;
+	auto out = reinterpret_cast<uint32_t *>(dst);
+	for (int y0 = 0; y0 < height; y0 += tile) {
+		for (int x0 = 0; x0 < width; x0 += tile) {
+			for (int y = y0; y < std::min(y0 + tile, height); ++y) {
+				auto row = reinterpret_cast<const uint32_t *>(src + y * src_pitch);
+				int out_x = reverse ? height - 1 - y : y;
+				for (int x = x0; x < std::min(x0 + tile, width); ++x)
+					out[x * height + out_x] = row[x];
+			}
+		}
+	}
+}
+
 /// @class FFmpegSourceVideoProvider
 /// @brief Implements video loading through the FFMS library.
 class FFmpegSourceVideoProvider final : public VideoProvider, FFmpegSourceProvider {
@@ -321,59 +350,38 @@ void FFmpegSourceVideoProvider::GetFrame(int n, VideoFrame &out) {
 	if (!frame)
 		throw VideoDecodeError(std::string("Failed to retrieve frame: ") +  ErrInfo.Buffer);
 
-	out.data.assign(frame->Data[0], frame->Data[0] + frame->Linesize[0] * Height);
-	out.flipped = false;
-	out.width = Width;
-	out.height = Height;
-	out.pitch = frame->Linesize[0];
+	// The frame has to be copied out of FFMS's buffer anyway, so flipping and
+	// rotation are done as part of that copy. Vertical flips are free, as the
+	// frame can just be marked as being stored bottom-up.
+	bool flip_h = false, flip_v = false;
+	int rotation = 0;
 #if FFMS_VERSION >= ((2 << 24) | (31 << 16) | (0 << 8) | 0)
-	// Handle flip
-	if (VideoInfo->Flip > 0)
-		for (int x = 0; x < Height; ++x)
-			for (int y = 0; y < Width / 2; ++y)
-				for (int ch = 0; ch < 4; ++ch)
-					std::swap(out.data[frame->Linesize[0] * x + 4 * y + ch], out.data[frame->Linesize[0] * x + 4 * (Width - 1 - y) + ch]);
-
-	else if (VideoInfo->Flip < 0)
-		for (int x = 0; x < Height / 2; ++x)
-			for (int y = 0; y < Width; ++y)
-				for (int ch = 0; ch < 4; ++ch)
-					std::swap(out.data[frame->Linesize[0] * x + 4 * y + ch], out.data[frame->Linesize[0] * (Height - 1 - x) + 4 * y + ch]);
+	flip_h = VideoInfo->Flip > 0;
+	flip_v = VideoInfo->Flip < 0;
 #endif
 #if FFMS_VERSION >= ((2 << 24) | (24 << 16) | (0 << 8) | 0)
-	// Handle rotation
-	if (VideoInfo->Rotation % 360 == 180 || VideoInfo->Rotation % 360 == -180) {
-		std::vector<unsigned char> data(std::move(out.data));
-		out.data.resize(Width * Height * 4);
-		for (int x = 0; x < Height; ++x)
-			for (int y = 0; y < Width; ++y)
-				for (int ch = 0; ch < 4; ++ch)
-					out.data[4 * (Width * x + y) + ch] = data[frame->Linesize[0] * (Height - 1 - x) + 4 * (Width - 1 - y) + ch];
-		out.pitch = 4 * Width;
+	rotation = (VideoInfo->Rotation % 360 + 360) % 360;
+#endif
+
+	const unsigned char *src = frame->Data[0];
+	const size_t src_pitch = frame->Linesize[0];
+
+	if (rotation == 90 || rotation == 270) {
+		// Each row of the output is a column of the frame
+		auto dst = out.Allocate(Height, Width, 4 * Height);
+		copy_transposed(dst, src, src_pitch, Width, Height, (rotation == 270) != flip_v);
+		out.flipped = (rotation == 90) != flip_h;
 	}
-	else if (VideoInfo->Rotation % 360 == 90 || VideoInfo->Rotation % 360 == -270) {
-		std::vector<unsigned char> data(std::move(out.data));
-		out.data.resize(Width * Height * 4);
-		for (int x = 0; x < Width; ++x)
-			for (int y = 0; y < Height; ++y)
-				for (int ch = 0; ch < 4; ++ch)
-					out.data[4 * (Height * x + y) + ch] = data[frame->Linesize[0] * y + 4 * (Width - 1 - x) + ch];
-		out.width = Height;
-		out.height = Width;
-		out.pitch = 4 * Height;
+	else if ((rotation == 180) != flip_h) {
+		auto dst = out.Allocate(Width, Height, 4 * Width);
+		copy_mirrored(dst, src, src_pitch, Width, Height);
+		out.flipped = (rotation == 180) != flip_v;
 	}
-	else if (VideoInfo->Rotation % 360 == 270 || VideoInfo->Rotation % 360 == -90) {
-		std::vector<unsigned char> data(std::move(out.data));
-		out.data.resize(Width * Height * 4);
-		for (int x = 0; x < Width; ++x)
-			for (int y = 0; y < Height; ++y)
-				for (int ch = 0; ch < 4; ++ch)
-					out.data[4 * (Height * x + y) + ch] = data[frame->Linesize[0] * (Height - 1 - y) + 4 * x + ch];
-		out.width = Height;
-		out.height = Width;
-		out.pitch = 4 * Height;
+	else {
+		auto dst = out.Allocate(Width, Height, src_pitch);
+		memcpy(dst, src, src_pitch * Height);
+		out.flipped = (rotation == 180) != flip_v;
 	}
-#endif
 }
 }
 
@@ -395,8 +395,7 @@ void YUV4MPEGVideoProvider::GetFrame(int n, VideoFrame &frame) {
 	auto src_y = reinterpret_cast<const unsigned char *>(file.read(seek_table[n], luma_sz + chroma_sz * 2));
 	auto src_u = src_y + luma_sz;
 	auto src_v = src_u + chroma_sz;
-	frame.data.resize(w * h * 4);
-	unsigned char *dst = &frame.data[0];
+	unsigned char *dst = frame.Allocate(w, h, w * 4);
 
 	for (int py = 0; py < h; ++py) {
 		for (int px = 0; px < w / 2; ++px) {
@@ -418,11 +417,6 @@ void YUV4MPEGVideoProvider::GetFrame(int n, VideoFrame &frame) {
 			src_v -= uv_width;
 		}
 	}
-
-	frame.flipped = false;
-	frame.width = w;
-	frame.height = h;
-	frame.pitch = w * 4;
 }
 }
 
@@ -116,6 +116,18 @@ bool VisualToolBase::IsDisplayed(AssDialogue *line) const {
 		&& c->videoController->FrameAtTime(line->End, agi::vfr::END) >= frame;
 }
 
+std::vector<AssDialogue *> VisualToolBase::GetDisplayedLines() const {
+	// Frame and time rounding differ slightly, so look up the lines around
+	// the frame from the time index and then check each one properly
+	int frame = c->videoController->GetFrameN();
+	auto lines = c->ass->LinesInRange(
+		c->videoController->TimeAtFrame(frame - 1),
+		c->videoController->TimeAtFrame(frame + 2));
+	lines.erase(remove_if(begin(lines), end(lines), [&](AssDialogue *line) { return !IsDisplayed(line); }), end(lines));
+	sort(begin(lines), end(lines), [](AssDialogue *a, AssDialogue *b) { return a->Row < b->Row; });
+	return lines;
+}
+
 void VisualToolBase::Commit(wxString message) {
 	file_changed_connection.Block();
 	if (message.empty())
@@ -340,7 +352,7 @@ void VisualTool<FeatureType>::RemoveSelection(FeatureType *feat) {
 typedef const std::vector<AssOverrideParameter> * param_vec;
 
 // Find a tag's parameters in a line or return nullptr if it's not found
-static param_vec find_tag(std::vector<std::unique_ptr<AssDialogueBlock>>& blocks, std::string const& tag_name) {
+static param_vec find_tag(std::vector<std::unique_ptr<AssDialogueBlock>> const& blocks, std::string const& tag_name) {
 	for (auto ovr : blocks | agi::of_type<AssDialogueBlockOverride>()) {
 		for (auto const& tag : ovr->Tags) {
 			if (tag.Name == tag_name)
@@ -363,10 +375,10 @@ static Vector2D vec_or_bad(param_vec tag, size_t x_idx, size_t y_idx) {
 }
 
 Vector2D VisualToolBase::GetLinePosition(AssDialogue *diag) {
-	auto blocks = diag->ParseTags();
+	auto blocks = diag->GetParsedTags();
 
-	if (Vector2D ret = vec_or_bad(find_tag(blocks, "\\pos"), 0, 1)) return ret;
-	if (Vector2D ret = vec_or_bad(find_tag(blocks, "\\move"), 0, 1)) return ret;
+	if (Vector2D ret = vec_or_bad(find_tag(*blocks, "\\pos"), 0, 1)) return ret;
+	if (Vector2D ret = vec_or_bad(find_tag(*blocks, "\\move"), 0, 1)) return ret;
 
 	// Get default position
 	auto margin = diag->Margin;
@@ -382,9 +394,9 @@ Vector2D VisualToolBase::GetLinePosition(AssDialogue *diag) {
 
 	param_vec align_tag;
 	int ovr_align = 0;
-	if ((align_tag = find_tag(blocks, "\\an")))
+	if ((align_tag = find_tag(*blocks, "\\an")))
 		ovr_align = (*align_tag)[0].Get<int>(ovr_align);
-	else if ((align_tag = find_tag(blocks, "\\a")))
+	else if ((align_tag = find_tag(*blocks, "\\a")))
 		ovr_align = AssStyle::SsaToAss((*align_tag)[0].Get<int>(2));
 
 	if (ovr_align > 0 && ovr_align <= 9)
@@ -414,14 +426,14 @@ Vector2D VisualToolBase::GetLinePosition(AssDialogue *diag) {
 }
 
 Vector2D VisualToolBase::GetLineOrigin(AssDialogue *diag) {
-	auto blocks = diag->ParseTags();
-	return vec_or_bad(find_tag(blocks, "\\org"), 0, 1);
+	auto blocks = diag->GetParsedTags();
+	return vec_or_bad(find_tag(*blocks, "\\org"), 0, 1);
 }
 
 bool VisualToolBase::GetLineMove(AssDialogue *diag, Vector2D &p1, Vector2D &p2, int &t1, int &t2) {
-	auto blocks = diag->ParseTags();
+	auto blocks = diag->GetParsedTags();
 
-	param_vec tag = find_tag(blocks, "\\move");
+	param_vec tag = find_tag(*blocks, "\\move");
 	if (!tag)
 		return false;
 
@@ -440,26 +452,26 @@ void VisualToolBase::GetLineRotation(AssDialogue *diag, float &rx, float &ry, fl
 	if (AssStyle *style = c->ass->GetStyle(diag->Style))
 		rz = style->angle;
 
-	auto blocks = diag->ParseTags();
+	auto blocks = diag->GetParsedTags();
 
-	if (param_vec tag = find_tag(blocks, "\\frx"))
+	if (param_vec tag = find_tag(*blocks, "\\frx"))
 		rx = tag->front().Get(rx);
-	if (param_vec tag = find_tag(blocks, "\\fry"))
+	if (param_vec tag = find_tag(*blocks, "\\fry"))
 		ry = tag->front().Get(ry);
-	if (param_vec tag = find_tag(blocks, "\\frz"))
+	if (param_vec tag = find_tag(*blocks, "\\frz"))
 		rz = tag->front().Get(rz);
-	else if ((tag = find_tag(blocks, "\\fr")))
+	else if ((tag = find_tag(*blocks, "\\fr")))
 		rz = tag->front().Get(rz);
 }
 
 void VisualToolBase::GetLineShear(AssDialogue *diag, float& fax, float& fay) {
 	fax = fay = 0.f;
 
-	auto blocks = diag->ParseTags();
+	auto blocks = diag->GetParsedTags();
 
-	if (param_vec tag = find_tag(blocks, "\\fax"))
+	if (param_vec tag = find_tag(*blocks, "\\fax"))
 		fax = tag->front().Get(fax);
-	if (param_vec tag = find_tag(blocks, "\\fay"))
+	if (param_vec tag = find_tag(*blocks, "\\fay"))
 		fay = tag->front().Get(fay);
 }
 
@@ -471,11 +483,11 @@ void VisualToolBase::GetLineScale(AssDialogue *diag, Vector2D &scale) {
 		y = style->scaley;
 	}
 
-	auto blocks = diag->ParseTags();
+	auto blocks = diag->GetParsedTags();
 
-	if (param_vec tag = find_tag(blocks, "\\fscx"))
+	if (param_vec tag = find_tag(*blocks, "\\fscx"))
 		x = tag->front().Get(x);
-	if (param_vec tag = find_tag(blocks, "\\fscy"))
+	if (param_vec tag = find_tag(*blocks, "\\fscy"))
 		y = tag->front().Get(y);
 
 	scale = Vector2D(x, y);
@@ -484,12 +496,12 @@ void VisualToolBase::GetLineScale(AssDialogue *diag, Vector2D &scale) {
 void VisualToolBase::GetLineClip(AssDialogue *diag, Vector2D &p1, Vector2D &p2, bool &inverse) {
 	inverse = false;
 
-	auto blocks = diag->ParseTags();
-	param_vec tag = find_tag(blocks, "\\iclip");
+	auto blocks = diag->GetParsedTags();
+	param_vec tag = find_tag(*blocks, "\\iclip");
 	if (tag)
 		inverse = true;
 	else
-		tag = find_tag(blocks, "\\clip");
+		tag = find_tag(*blocks, "\\clip");
 
 	if (tag && tag->size() == 4) {
 		p1 = vec_or_bad(tag, 0, 1);
@@ -502,16 +514,16 @@ void VisualToolBase::GetLineClip(AssDialogue *diag, Vector2D &p1, Vector2D &p2,
 }
 
 std::string VisualToolBase::GetLineVectorClip(AssDialogue *diag, int &scale, bool &inverse) {
-	auto blocks = diag->ParseTags();
+	auto blocks = diag->GetParsedTags();
 
 	scale = 1;
 	inverse = false;
 
-	param_vec tag = find_tag(blocks, "\\iclip");
+	param_vec tag = find_tag(*blocks, "\\iclip");
 	if (tag)
 		inverse = true;
 	else
-		tag = find_tag(blocks, "\\clip");
+		tag = find_tag(*blocks, "\\clip");
 
 	if (tag && tag->size() == 4) {
 		return agi::format("m %d %d l %d %d %d %d %d %d"
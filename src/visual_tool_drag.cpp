@@ -116,10 +116,8 @@ void VisualToolDrag::OnFileChanged() {
 	primary = nullptr;
 	active_feature = nullptr;
 
-	for (auto& diag : c->ass->Events) {
-		if (IsDisplayed(&diag))
-			MakeFeatures(&diag);
-	}
+	for (auto diag : GetDisplayedLines())
+		MakeFeatures(diag);
 
 	UpdateToggleButtons();
 }
@@ -128,28 +126,33 @@ void VisualToolDrag::OnFrameChanged() {
 	if (primary && !IsDisplayed(primary->line))
 		primary = nullptr;
 
+	auto lines = GetDisplayedLines();
+	std::vector<AssDialogue *> displayed(lines);
+	sort(displayed.begin(), displayed.end());
+	auto remove_feature = [&](feature_list::iterator feat) {
+		if (&*feat == active_feature) active_feature = nullptr;
+		feat->line = nullptr;
+		RemoveSelection(&*feat);
+		return features.erase(feat);
+	};
+
+	// Features are kept in file order, so walk both lists together
 	auto feat = features.begin();
 	auto end = features.end();
-
-	for (auto& diag : c->ass->Events) {
-		if (IsDisplayed(&diag)) {
-			// Features don't exist and should
-			if (feat == end || feat->line != &diag)
-				MakeFeatures(&diag, feat);
-			// Move past already existing features for the line
-			else
-				while (feat != end && feat->line == &diag) ++feat;
-		}
-		else {
-			// Remove all features for this line (if any)
-			while (feat != end && feat->line == &diag) {
-				if (&*feat == active_feature) active_feature = nullptr;
-				feat->line = nullptr;
-				RemoveSelection(&*feat);
-				feat = features.erase(feat);
-			}
-		}
+	for (auto diag : lines) {
+		// Remove the features for lines which are no longer displayed
+		while (feat != end && feat->line != diag && !boost::binary_search(displayed, feat->line))
+			feat = remove_feature(feat);
+
+		// Features don't exist and should
+		if (feat == end || feat->line != diag)
+			MakeFeatures(diag, feat);
+		// Move past already existing features for the line
+		else
+			while (feat != end && feat->line == diag) ++feat;
 	}
+	while (feat != end)
+		feat = remove_feature(feat);
 }
 
 template<class C, class T> static bool line_not_present(C const& set, T const& it) {
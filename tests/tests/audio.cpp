@@ -16,6 +16,7 @@
 
 #include <main.h>
 
+#include <libaegisub/audio/peak_pyramid.h>
 #include <libaegisub/audio/provider.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/make_unique.h>
@@ -228,6 +229,142 @@ TEST(lagi_audio, hd_cache) {
 		ASSERT_EQ(static_cast<uint16_t>((1 << 22) - 256 + i), buff[i]);
 }
 
+TEST(lagi_audio, peak_pyramid) {
+	std::vector<int16_t> samples(100000);
+	for (size_t i = 0; i < samples.size(); ++i)
+		samples[i] = static_cast<int16_t>((i * 7919) % 65536 - 32768);
+
+	agi::AudioPeakPyramid peaks(samples.size());
+	EXPECT_EQ(0, peaks.GetReadySamples());
+
+	// Feed in uneven chunks to exercise partially filled blocks
+	for (size_t i = 0; i < samples.size(); i += 1000)
+		peaks.AddSamples(&samples[i], std::min<size_t>(1000, samples.size() - i));
+	EXPECT_EQ(samples.size(), peaks.GetReadySamples());
+
+	auto check = [&](int64_t start, int64_t end) {
+		// Queries are widened to block boundaries, so compare against the
+		// block-aligned range at the finest level
+		const int64_t block = agi::AudioPeakPyramid::BlockSize;
+		int expected_min = 0, expected_max = 0;
+		for (int64_t i = start / block * block; i < std::min<int64_t>((end + block - 1) / block * block, samples.size()); ++i) {
+			expected_min = std::min<int>(expected_min, samples[i]);
+			expected_max = std::max<int>(expected_max, samples[i]);
+		}
+		auto peak = peaks.GetPeak(start, end);
+		EXPECT_GE(expected_min, peak.min);
+		EXPECT_LE(expected_max, peak.max);
+		EXPECT_LE(peak.min, peak.avg_min);
+		EXPECT_GE(peak.max, peak.avg_max);
+	};
+	check(0, 256);
+	check(0, 100000);
+	check(1234, 5678);
+	check(99000, 100000);
+
+	auto peak = peaks.GetPeak(0, samples.size());
+	EXPECT_EQ(-32768, peak.min);
+	EXPECT_EQ(32767, peak.max);
+}
+
+TEST(lagi_audio, peak_pyramid_partial) {
+	agi::AudioPeakPyramid peaks(10000);
+	std::vector<int16_t> samples(1000, 100);
+	peaks.AddSamples(samples.data(), samples.size());
+	EXPECT_EQ(768, peaks.GetReadySamples());
+
+	auto peak = peaks.GetPeak(0, 768);
+	EXPECT_EQ(0, peak.min);
+	EXPECT_EQ(100, peak.max);
+	EXPECT_EQ(100, peak.avg_max);
+}
+
+TEST(lagi_audio, peak_pyramid_save_load) {
+	auto path = agi::Path().Decode("?temp/peaks");
+	agi::fs::Remove(path);
+
+	std::vector<int16_t> samples(5000);
+	for (size_t i = 0; i < samples.size(); ++i)
+		samples[i] = static_cast<int16_t>(i * 13);
+
+	agi::AudioPeakPyramid partial(samples.size());
+	partial.AddSamples(samples.data(), 1000);
+	EXPECT_FALSE(partial.Save(path));
+
+	agi::AudioPeakPyramid peaks(samples.size());
+	peaks.AddSamples(samples.data(), samples.size());
+	ASSERT_TRUE(peaks.Save(path));
+
+	agi::AudioPeakPyramid loaded(samples.size());
+	ASSERT_TRUE(loaded.Load(path));
+	EXPECT_EQ(samples.size(), loaded.GetReadySamples());
+	for (int64_t start : {0, 300, 1024, 4000}) {
+		auto a = peaks.GetPeak(start, start + 700);
+		auto b = loaded.GetPeak(start, start + 700);
+		EXPECT_EQ(a.min, b.min);
+		EXPECT_EQ(a.max, b.max);
+		EXPECT_EQ(a.avg_min, b.avg_min);
+		EXPECT_EQ(a.avg_max, b.avg_max);
+	}
+
+	// Saved for a stream of a different length
+	agi::AudioPeakPyramid mismatched(samples.size() + 1);
+	EXPECT_FALSE(mismatched.Load(path));
+	EXPECT_EQ(0, mismatched.GetReadySamples());
+
+	agi::fs::Remove(path);
+}
+
+TEST(lagi_audio, ram_cache_reuses_saved_peaks) {
+	auto path = agi::Path().Decode("?temp/ram_peaks");
+	agi::fs::Remove(path);
+
+	{
+		auto provider = agi::CreateRAMAudioProvider(agi::make_unique<TestAudioProvider<>>(), path);
+		while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+	}
+	ASSERT_TRUE(agi::fs::FileExists(path));
+
+	// The saved summary is complete before any audio has been decoded
+	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<TestAudioProvider<>>(), path);
+	auto peaks = provider->GetPeakPyramid();
+	ASSERT_NE(nullptr, peaks);
+	EXPECT_EQ(provider->GetNumSamples(), peaks->GetReadySamples());
+	EXPECT_EQ(1024 + 255, peaks->GetPeak(1024, 1024 + 256).max);
+	provider.reset();
+
+	agi::fs::Remove(path);
+}
+
+TEST(lagi_audio, ram_cache_peaks) {
+	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<TestAudioProvider<>>());
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	auto peaks = provider->GetPeakPyramid();
+	ASSERT_NE(nullptr, peaks);
+	EXPECT_EQ(provider->GetNumSamples(), peaks->GetReadySamples());
+
+	// The test provider's samples are an incrementing counter, so each
+	// aligned block of 256 samples is a short ramp
+	auto peak = peaks->GetPeak(1024, 1024 + 256);
+	EXPECT_EQ(0, peak.min);
+	EXPECT_EQ(1024 + 255, peak.max);
+
+	peak = peaks->GetPeak(0, provider->GetNumSamples());
+	EXPECT_EQ(-32768, peak.min);
+	EXPECT_EQ(32767, peak.max);
+}
+
+TEST(lagi_audio, hd_cache_peaks) {
+	auto provider = agi::CreateHDAudioProvider(agi::make_unique<TestAudioProvider<>>(), agi::Path().Decode("?temp"));
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	auto peaks = provider->GetPeakPyramid();
+	ASSERT_NE(nullptr, peaks);
+	auto peak = peaks->GetPeak(2048, 2048 + 256);
+	EXPECT_EQ(2048 + 255, peak.max);
+}
+
 TEST(lagi_audio, convert_8bit) {
 	auto provider = agi::CreateConvertAudioProvider(agi::make_unique<TestAudioProvider<uint8_t>>());
 
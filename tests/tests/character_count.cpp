@@ -55,6 +55,28 @@ TEST(lagi_character_count, ignore_blocks_unclosed) {
 	EXPECT_EQ(6, agi::CharacterCount("{hello", agi::IGNORE_BLOCKS));
 }
 
+TEST(lagi_character_count, latin) {
+	EXPECT_EQ(5, agi::CharacterCount("h\xc3\xa9llo", agi::IGNORE_NONE));
+	EXPECT_EQ(6, agi::CharacterCount("\xc2\xbfh\xc3\xa9llo", agi::IGNORE_NONE));
+	EXPECT_EQ(5, agi::CharacterCount("\xc2\xbfh\xc3\xa9llo", agi::IGNORE_PUNCTUATION));
+	EXPECT_EQ(5, agi::CharacterCount("h\xc2\xa0" "ello", agi::IGNORE_WHITESPACE));
+	EXPECT_EQ(2, agi::CharacterCount("e\xcc\x81" "e", agi::IGNORE_NONE));
+}
+
+TEST(lagi_character_count, crlf) {
+	EXPECT_EQ(3, agi::CharacterCount("a\r\nb", agi::IGNORE_NONE));
+	EXPECT_EQ(4, agi::CharacterCount("a\n\rb", agi::IGNORE_NONE));
+	EXPECT_EQ(3, agi::CharacterCount("a\r\nb", agi::IGNORE_WHITESPACE));
+}
+
+TEST(lagi_character_count, long_ascii) {
+	std::string str(1000, 'a');
+	EXPECT_EQ(1000, agi::CharacterCount(str, agi::IGNORE_NONE));
+	str[999] = '\xc3';
+	str += '\xa9';
+	EXPECT_EQ(1000, agi::CharacterCount(str, agi::IGNORE_NONE));
+}
+
 TEST(lagi_character_count, line_length) {
 	EXPECT_EQ(5, agi::MaxLineLength("hello", agi::IGNORE_NONE));
 	EXPECT_EQ(5, agi::MaxLineLength("hello\\Nasdf", agi::IGNORE_NONE));
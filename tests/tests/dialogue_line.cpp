@@ -0,0 +1,201 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/ass/dialogue_line.h>
+
+#include <main.h>
+
+#include <chrono>
+#include <cstdio>
+
+using agi::ass::DialogueLine;
+
+class lagi_dialogue_line : public libagi { };
+
+namespace {
+bool parse(std::string const& str, DialogueLine &line) {
+	return agi::ass::ParseDialogue(str.data(), str.data() + str.size(), line);
+}
+
+std::string str(agi::ass::CharRange range) {
+	return std::string(range.begin(), range.end());
+}
+
+std::string roundtrip(std::string const& str) {
+	DialogueLine line;
+	if (!parse(str, line)) return "";
+	std::string out;
+	agi::ass::SerializeDialogue(line, out);
+	return out;
+}
+}
+
+TEST(lagi_dialogue_line, parses_fields) {
+	DialogueLine line;
+	ASSERT_TRUE(parse("Dialogue: 2,0:01:02.34,1:00:00.00, Default ,Actor,10,20,30,Effect,Text, with commas ", line));
+	EXPECT_FALSE(line.comment);
+	EXPECT_EQ(2, line.layer);
+	EXPECT_EQ(62340, (int)line.start);
+	EXPECT_EQ(3600000, (int)line.end);
+	EXPECT_EQ("Default", str(line.style));
+	EXPECT_EQ("Actor", str(line.actor));
+	EXPECT_EQ(10, line.margin[0]);
+	EXPECT_EQ(20, line.margin[1]);
+	EXPECT_EQ(30, line.margin[2]);
+	EXPECT_EQ("Effect", str(line.effect));
+	EXPECT_EQ("Text, with commas ", str(line.text));
+	EXPECT_TRUE(line.extradata_ids.empty());
+}
+
+TEST(lagi_dialogue_line, parses_comments) {
+	DialogueLine line;
+	ASSERT_TRUE(parse("Comment: 0,0:00:00.00,0:00:01.00,,,0,0,0,,", line));
+	EXPECT_TRUE(line.comment);
+	EXPECT_EQ("", str(line.text));
+}
+
+TEST(lagi_dialogue_line, ssa_marked) {
+	DialogueLine line;
+	ASSERT_TRUE(parse("Dialogue: Marked=0,0:00:00.00,0:00:01.00,Default,,0,0,0,,text", line));
+	EXPECT_EQ(0, line.layer);
+}
+
+TEST(lagi_dialogue_line, clamps_margins) {
+	DialogueLine line;
+	ASSERT_TRUE(parse("Dialogue: 0,0:00:00.00,0:00:01.00,Default,,-5,10000,9999,,text", line));
+	EXPECT_EQ(0, line.margin[0]);
+	EXPECT_EQ(9999, line.margin[1]);
+	EXPECT_EQ(9999, line.margin[2]);
+}
+
+TEST(lagi_dialogue_line, rejects_malformed_lines) {
+	DialogueLine line;
+	EXPECT_FALSE(parse("", line));
+	EXPECT_FALSE(parse("Style: 0,0:00:00.00,0:00:01.00,Default,,0,0,0,,text", line));
+	EXPECT_FALSE(parse("Dialogue: 0,0:00:00.00,0:00:01.00,Default,,0,0,0", line));
+	EXPECT_FALSE(parse("Dialogue: x,0:00:00.00,0:00:01.00,Default,,0,0,0,,text", line));
+	EXPECT_FALSE(parse("Dialogue: 0,0:00:00.00,0:00:01.00,Default,,0,1a,0,,text", line));
+	EXPECT_FALSE(parse("Dialogue: 0,0:00:00.00,0:00:01.00,Default,,0,,0,,text", line));
+	EXPECT_FALSE(parse("Dialogue: 99999999999,0:00:00.00,0:00:01.00,Default,,0,0,0,,text", line));
+}
+
+TEST(lagi_dialogue_line, margins_are_not_trimmed) {
+	DialogueLine line;
+	EXPECT_FALSE(parse("Dialogue: 0,0:00:00.00,0:00:01.00,Default,, 10,0,0,,text", line));
+	EXPECT_FALSE(parse("Dialogue: 0,0:00:00.00,0:00:01.00,Default,,0,10 ,0,,text", line));
+	EXPECT_FALSE(parse("Dialogue: 0,0:00:00.00,0:00:01.00,Default,,0,0,\t10,,text", line));
+	EXPECT_TRUE(parse("Dialogue: 0,0:00:00.00,0:00:01.00,Default,,+10,0,0,,text", line));
+	EXPECT_EQ(10, line.margin[0]);
+}
+
+TEST(lagi_dialogue_line, extradata) {
+	DialogueLine line;
+	ASSERT_TRUE(parse("Dialogue: 0,0:00:00.00,0:00:01.00,Default,,0,0,0,,{=1=23}{\\b1}text", line));
+	ASSERT_EQ(2u, line.extradata_ids.size());
+	EXPECT_EQ(1u, line.extradata_ids[0]);
+	EXPECT_EQ(23u, line.extradata_ids[1]);
+	EXPECT_EQ("{\\b1}text", str(line.text));
+
+	for (auto text : {"{=}text", "{=1=}text", "{=1", "{=a}text", "{=99999999999", "{=99999999999=}text", "{\\b1}text"}) {
+		ASSERT_TRUE(parse(std::string("Dialogue: 0,0:00:00.00,0:00:01.00,Default,,0,0,0,,") + text, line));
+		EXPECT_TRUE(line.extradata_ids.empty());
+		EXPECT_EQ(text, str(line.text));
+	}
+
+	ASSERT_TRUE(parse("Dialogue: 0,0:00:00.00,0:00:01.00,Default,,0,0,0,,{=4294967295}text", line));
+	ASSERT_EQ(1u, line.extradata_ids.size());
+	EXPECT_EQ(4294967295u, line.extradata_ids[0]);
+
+	EXPECT_FALSE(parse("Dialogue: 0,0:00:00.00,0:00:01.00,Default,,0,0,0,,{=4294967296}text", line));
+	EXPECT_FALSE(parse("Dialogue: 0,0:00:00.00,0:00:01.00,Default,,0,0,0,,{=1=99999999999}text", line));
+}
+
+TEST(lagi_dialogue_line, serialize) {
+	DialogueLine line;
+	std::string style = "Def,ault", actor = "a,b", effect = "", text = "line\none\r";
+	line.layer = -3;
+	line.start = agi::Time(62345);
+	line.end = agi::Time(3600000);
+	line.style = agi::ass::CharRange(&style[0], &style[0] + style.size());
+	line.actor = agi::ass::CharRange(&actor[0], &actor[0] + actor.size());
+	line.effect = agi::ass::CharRange(effect.data(), effect.data());
+	line.text = agi::ass::CharRange(&text[0], &text[0] + text.size());
+	line.margin[1] = 15;
+	line.extradata_ids = {4, 5};
+
+	std::string out = "prefix|";
+	agi::ass::SerializeDialogue(line, out);
+	EXPECT_EQ("prefix|Dialogue: -3,0:01:02.35,1:00:00.00,Def;ault,a;b,0,15,0,,{=4=5}lineone", out);
+
+	line.comment = true;
+	out.clear();
+	agi::ass::SerializeDialogue(line, out);
+	EXPECT_EQ(0u, out.find("Comment: -3,"));
+}
+
+TEST(lagi_dialogue_line, roundtrip) {
+	for (auto str : {
+		"Dialogue: 0,0:00:00.00,0:00:01.00,Default,,0,0,0,,text",
+		"Comment: 5,1:23:45.67,9:59:59.99,Style,Actor,1,22,333,Effect,{=1}{\\i1}a, b, c",
+		"Dialogue: 0,0:00:00.00,0:00:00.00,,,0,0,0,,",
+	})
+		EXPECT_EQ(str, roundtrip(str));
+}
+
+TEST(lagi_dialogue_line, DISABLED_benchmark) {
+	const int count = 500000;
+	std::vector<std::string> lines;
+	lines.reserve(count);
+	for (int i = 0; i < count; ++i) {
+		DialogueLine line;
+		std::string style = "Default", text = "{\\an8\\pos(320,50)}Some text for line number " + std::to_string(i);
+		line.layer = i % 3;
+		line.start = agi::Time(i * 1000);
+		line.end = agi::Time(i * 1000 + 2500);
+		line.style = agi::ass::CharRange(&style[0], &style[0] + style.size());
+		line.text = agi::ass::CharRange(&text[0], &text[0] + text.size());
+		std::string out;
+		agi::ass::SerializeDialogue(line, out);
+		lines.push_back(std::move(out));
+	}
+
+	auto now = [] { return std::chrono::steady_clock::now(); };
+	auto per_second = [](std::chrono::steady_clock::duration d) {
+		return count / std::chrono::duration<double>(d).count();
+	};
+
+	DialogueLine line;
+	size_t chars = 0;
+	auto start = now();
+	for (auto const& str : lines) {
+		parse(str, line);
+		chars += line.text.size();
+	}
+	auto parse_time = now() - start;
+
+	std::string out;
+	start = now();
+	for (auto const& str : lines) {
+		parse(str, line);
+		out.clear();
+		agi::ass::SerializeDialogue(line, out);
+		chars += out.size();
+	}
+	auto both_time = now() - start;
+
+	printf("parse: %.0f lines/s, parse and serialize: %.0f lines/s (%zu chars)\n",
+		per_second(parse_time), per_second(both_time), chars);
+}
@@ -70,3 +70,25 @@ TEST(lagi_line, string) {
 	expect_eq<std::string>(" white space ", " white space ");
 	expect_eq<std::string>("blank\n\nlines\n", "blank", "", "lines", "");
 }
+
+TEST(lagi_line, block_boundaries) {
+	// Enough lines of varying length that some of them are split between the
+	// blocks the decoder reads, plus one line longer than a block
+	std::vector<std::string> lines;
+	std::string utf8;
+	for (int i = 0; i < 20000; ++i) {
+		lines.push_back(std::string(i % 37, 'a') + "\xE3\x81\x82" + std::to_string(i));
+		utf8 += lines.back() + (i % 2 ? "\r\n" : "\n");
+	}
+	lines.push_back(std::string(200000, 'b'));
+	utf8 += lines.back();
+
+	for (auto encoding : {"utf-16", "shift_jis"}) {
+		agi::charset::IconvWrapper conv("utf-8", encoding);
+		std::stringstream ss(conv.Convert(utf8));
+
+		std::vector<std::string> read;
+		EXPECT_NO_THROW(std::copy(agi::line_iterator<std::string>(ss, encoding), agi::line_iterator<std::string>(), back_inserter(read)));
+		EXPECT_TRUE(lines == read) << encoding;
+	}
+}